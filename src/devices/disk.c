@@ -1,6 +1,7 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/timer.h"
@@ -32,6 +33,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +49,13 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+/* Maximum number of sectors transferred by a single command.
+   The Sector Count register is 8 bits wide, where 0 means 256. */
+#define MAX_SECTORS_PER_CMD 256
 
 /* An ATA device. */
 struct disk
@@ -57,20 +66,39 @@ struct disk
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+    int multiple_cnt;           /* Sectors per interrupt in READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
   };
 
 /* An ATA channel (aka controller).
-   Each channel can control up to two disks. */
+   Each channel can control up to two disks.
+
+   Only one request at a time can use the controller.  Requests
+   that arrive while it is busy wait in the channel's queue, and
+   when the current request completes, the next one is chosen
+   with the C-SCAN elevator algorithm: the request with the
+   lowest sector at or above the position of the previous
+   request, wrapping around to the lowest sector overall when
+   there is none.  To keep latency bounded, a request that has
+   waited longer than DISK_DEADLINE_MS goes next regardless of
+   its position. */
 struct channel
   {
     char name[8];               /* Name, e.g. "hd0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
+    struct lock queue_lock;     /* Protects busy, head and queue. */
+    bool busy;                  /* True while a request owns the
+                                   controller. */
+    disk_sector_t head;         /* Sector following the last one
+                                   transferred. */
+    struct list queue;          /* Waiting `struct disk_request's, in
+                                   arrival order. */
+
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
@@ -78,6 +106,19 @@ struct channel
     struct disk devices[2];     /* The devices on this channel. */
   };
 
+/* A request waiting for a busy channel. */
+struct disk_request
+  {
+    struct list_elem elem;      /* Element in channel's queue. */
+    disk_sector_t sec_no;       /* First sector to transfer. */
+    int64_t deadline;           /* Timer tick by which to dispatch. */
+    struct semaphore granted;   /* Up'd when the request owns the channel. */
+  };
+
+/* Milliseconds a request may wait before it is dispatched ahead
+   of the elevator order. */
+#define DISK_DEADLINE_MS 100
+
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
@@ -85,8 +126,9 @@ static struct channel channels[CHANNEL_CNT];
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static void set_multiple_mode (struct disk *, int multiple_cnt);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -96,6 +138,9 @@ static bool wait_while_busy (const struct disk *);
 static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
+static void channel_acquire (struct channel *, disk_sector_t);
+static void channel_release (struct channel *, disk_sector_t);
+
 static void interrupt_handler (struct intr_frame *);
 
 /* Initialize the disk subsystem and detect disks. */
@@ -124,7 +169,10 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init (&c->queue_lock);
+      c->busy = false;
+      c->head = 0;
+      list_init (&c->queue);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
 
@@ -138,6 +186,7 @@ disk_init (void)
 
           d->is_ata = false;
           d->capacity = 0;
+          d->multiple_cnt = 0;
 
           d->read_cnt = d->write_cnt = 0;
         }
@@ -219,21 +268,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 {
-  struct channel *c;
-
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
-
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
-  lock_release (&c->lock);
+  disk_read_multi (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -244,23 +279,192 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
+  disk_write_multi (d, sec_no, 1, buffer);
+}
+
+/* Reads the CNT consecutive sectors starting at SEC_NO from disk
+   D into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Up to MAX_SECTORS_PER_CMD sectors are transferred by
+   each command, and if the disk supports READ MULTIPLE, the disk
+   interrupts once per D->multiple_cnt sectors instead of once
+   per sector.
+   Internally schedules accesses to disks, so external per-disk
+   locking is unneeded. */
+void
+disk_read_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+                 void *buffer_)
+{
+  uint8_t *buffer = buffer_;
   struct channel *c;
+  size_t block_cnt;
 
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
   c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  d->write_cnt++;
-  lock_release (&c->lock);
+  block_cnt = d->multiple_cnt > 0 ? d->multiple_cnt : 1;
+  channel_acquire (c, sec_no);
+  while (cnt > 0)
+    {
+      size_t cmd_cnt = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t left;
+
+      select_sector (d, sec_no, cmd_cnt);
+      issue_pio_command (c, (d->multiple_cnt > 0
+                             ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY));
+      for (left = cmd_cnt; left > 0; )
+        {
+          size_t i, n = left < block_cnt ? left : block_cnt;
+
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + (cmd_cnt - left));
+          for (i = 0; i < n; i++)
+            {
+              input_sector (c, buffer);
+              buffer += DISK_SECTOR_SIZE;
+            }
+          left -= n;
+        }
+
+      d->read_cnt += cmd_cnt;
+      sec_no += cmd_cnt;
+      cnt -= cmd_cnt;
+    }
+  channel_release (c, sec_no);
 }
-
+
+/* Writes the CNT consecutive sectors starting at SEC_NO to disk
+   D from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Uses WRITE MULTIPLE if the disk supports it, as
+   disk_read_multi() does for reads.
+   Internally schedules accesses to disks, so external per-disk
+   locking is unneeded. */
+void
+disk_write_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+                  const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  struct channel *c;
+  size_t block_cnt;
+
+  ASSERT (d != NULL);
+  ASSERT (buffer != NULL);
+
+  c = d->channel;
+  block_cnt = d->multiple_cnt > 0 ? d->multiple_cnt : 1;
+  channel_acquire (c, sec_no);
+  while (cnt > 0)
+    {
+      size_t cmd_cnt = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t left;
+
+      select_sector (d, sec_no, cmd_cnt);
+      issue_pio_command (c, (d->multiple_cnt > 0
+                             ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY));
+      for (left = cmd_cnt; left > 0; )
+        {
+          size_t i, n = left < block_cnt ? left : block_cnt;
+
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + (cmd_cnt - left));
+          for (i = 0; i < n; i++)
+            {
+              output_sector (c, buffer);
+              buffer += DISK_SECTOR_SIZE;
+            }
+          sema_down (&c->completion_wait);
+          left -= n;
+        }
+
+      d->write_cnt += cmd_cnt;
+      sec_no += cmd_cnt;
+      cnt -= cmd_cnt;
+    }
+  channel_release (c, sec_no);
+}
+
+/* Request scheduling. */
+
+/* Waits until channel C may be used for a request that starts at
+   sector SEC_NO, which may take a while if other requests are
+   queued.  Must be followed by channel_release(). */
+static void
+channel_acquire (struct channel *c, disk_sector_t sec_no)
+{
+  struct disk_request r;
+
+  lock_acquire (&c->queue_lock);
+  if (!c->busy)
+    {
+      c->busy = true;
+      lock_release (&c->queue_lock);
+      return;
+    }
+
+  r.sec_no = sec_no;
+  r.deadline = timer_ticks () + DISK_DEADLINE_MS * TIMER_FREQ / 1000;
+  sema_init (&r.granted, 0);
+  list_push_back (&c->queue, &r.elem);
+  lock_release (&c->queue_lock);
+
+  /* The channel stays busy when it is handed over to us. */
+  sema_down (&r.granted);
+}
+
+/* Releases channel C, whose current request ended just before
+   sector HEAD, and hands it over to the next queued request, if
+   any. */
+static void
+channel_release (struct channel *c, disk_sector_t head)
+{
+  struct list_elem *e;
+  struct disk_request *next = NULL;
+
+  lock_acquire (&c->queue_lock);
+  ASSERT (c->busy);
+  c->head = head;
+
+  if (!list_empty (&c->queue))
+    {
+      struct disk_request *oldest
+        = list_entry (list_front (&c->queue), struct disk_request, elem);
+
+      if (timer_ticks () >= oldest->deadline)
+        next = oldest;
+      else
+        {
+          /* C-SCAN: lowest sector at or after the head, or else
+             the lowest sector of all. */
+          struct disk_request *lowest = NULL;
+
+          for (e = list_begin (&c->queue); e != list_end (&c->queue);
+               e = list_next (e))
+            {
+              struct disk_request *r
+                = list_entry (e, struct disk_request, elem);
+              if (r->sec_no >= head
+                  && (next == NULL || r->sec_no < next->sec_no))
+                next = r;
+              if (lowest == NULL || r->sec_no < lowest->sec_no)
+                lowest = r;
+            }
+          if (next == NULL)
+            next = lowest;
+        }
+      list_remove (&next->elem);
+    }
+
+  if (next != NULL)
+    sema_up (&next->granted);
+  else
+    c->busy = false;
+  lock_release (&c->queue_lock);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -386,6 +590,11 @@ identify_ata_device (struct disk *d)
   /* Calculate capacity. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+  /* Enable READ/WRITE MULTIPLE with the largest block size the
+     disk supports.  See [ATA-3] 8.16 and 8.37. */
+  if ((id[47] & 0xff) > 1)
+    set_multiple_mode (d, id[47] & 0xff);
+
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
   if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -404,6 +613,24 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* Sends a SET MULTIPLE MODE command to disk D, asking it to
+   transfer MULTIPLE_CNT sectors per interrupt in READ MULTIPLE
+   and WRITE MULTIPLE commands.  Sets D's multiple_cnt member if
+   the disk accepts. */
+static void
+set_multiple_mode (struct disk *d, int multiple_cnt)
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), multiple_cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+    d->multiple_cnt = multiple_cnt;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -426,18 +653,20 @@ print_ata_string (char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection
+   registers, selecting CNT sectors starting at SEC_NO.  (We use
+   LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no)
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < d->capacity);
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
+  ASSERT (sec_no + cnt <= d->capacity);
+  ASSERT (sec_no + cnt <= (1UL << 28));
 
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
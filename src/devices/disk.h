@@ -2,6 +2,7 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -22,5 +23,8 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multi (struct disk *, disk_sector_t, size_t cnt, void *);
+void disk_write_multi (struct disk *, disk_sector_t, size_t cnt,
+                       const void *);
 
 #endif /* devices/disk.h */
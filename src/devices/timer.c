@@ -13,6 +13,11 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* List of threads sleeping in timer_sleep(), in order of
+   increasing wakeup_tick.  Threads are put on it with
+   interrupts off and taken off by timer_interrupt(). */
+static struct list sleep_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -20,7 +25,26 @@ static unsigned loops_per_tick;
 /* Interrupts per second, written only by timer_init */
 uint16_t TIMER_FREQ = 0;
 
+/* -tickless: If true, the periodic timer interrupt is stopped
+   while the CPU is idle.  Controlled by kernel command-line
+   option "-tickless". */
+bool timer_tickless = false;
+
+/* 8254 input frequency. */
+#define PIT_HZ 1193180
+
+/* 8254 input clocks per timer tick. */
+static uint16_t tick_count;
+
+/* If nonzero, the periodic interrupt is stopped and the 8254
+   counts down this many ticks in one-shot mode. */
+static int64_t oneshot_ticks;
+
 static intr_handler_func timer_interrupt;
+static list_less_func wakeup_less;
+static void pit_program (uint8_t control, uint16_t count);
+static void catch_up (int64_t skipped);
+static void wake_sleepers (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -38,12 +62,11 @@ timer_init (const uint16_t timer_freq)
 
   /* 8254 input frequency divided by TIMER_FREQ, rounded to
      nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  tick_count = (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ;
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  pit_program (0x34, tick_count); /* Counter 0, mode 2 (periodic). */
 
+  list_init (&sleep_list);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -81,7 +104,10 @@ timer_calibrate (void)
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.
+   While the tick is stopped by timer_idle_enter() only the idle
+   thread and interrupt handlers run; the ticks skipped are added
+   before any other thread gets to run again. */
 int64_t
 timer_ticks (void)
 {
@@ -100,15 +126,90 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Suspends execution for approximately TICKS timer ticks. */
+/* Suspends execution for approximately TICKS timer ticks.
+   The thread is blocked on sleep_list until timer_interrupt()
+   wakes it, so it uses no CPU time in the meantime. */
 void
 timer_sleep (int64_t ticks)
 {
-  int64_t start = timer_ticks ();
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks)
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  t->wakeup_tick = timer_ticks () + ticks;
+  list_insert_ordered (&sleep_list, &t->elem, wakeup_less, NULL);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Called by the idle thread, with interrupts off, right before
+   it halts the CPU.  In tickless mode, stops the periodic
+   interrupt and programs the 8254 to interrupt once, when the
+   first sleeping thread is due or when the counter can count no
+   further, whichever comes first. */
+void
+timer_idle_enter (void)
+{
+  int64_t skip;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!timer_tickless || oneshot_ticks != 0)
+    return;
+
+  skip = UINT16_MAX / tick_count;
+  if (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_tick - ticks < skip)
+        skip = t->wakeup_tick - ticks;
+    }
+  if (skip < 2)
+    return;
+
+  oneshot_ticks = skip;
+  pit_program (0x30, skip * tick_count); /* Counter 0, mode 0 (one-shot). */
+}
+
+/* Called by the scheduler, with interrupts off, when the idle
+   thread gives up the CPU.  If the periodic interrupt is
+   stopped, accounts for the ticks that passed since and
+   restarts it. */
+void
+timer_idle_exit (void)
+{
+  int64_t skipped;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (oneshot_ticks == 0)
+    return;
+
+  /* Read back the status of counter 0.  Bit 7 is its output,
+     which goes high when the count reaches zero. */
+  outb (0x43, 0xe2);
+  if (inb (0x40) & 0x80)
+    {
+      /* The countdown is over.  Its interrupt is pending and
+         will count the last tick. */
+      skipped = oneshot_ticks - 1;
+    }
+  else
+    {
+      /* Latch counter 0 and read what is left of the count. */
+      unsigned left;
+      outb (0x43, 0x00);
+      left = inb (0x40);
+      left |= inb (0x40) << 8;
+      skipped = (oneshot_ticks * tick_count - left) / tick_count;
+    }
+
+  oneshot_ticks = 0;
+  pit_program (0x34, tick_count);
+  catch_up (skipped);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -144,8 +245,64 @@ timer_print_stats (void)
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  if (oneshot_ticks != 0)
+    {
+      /* The one-shot countdown started by timer_idle_enter() is
+         over.  This interrupt counts its last tick. */
+      int64_t skipped = oneshot_ticks - 1;
+      oneshot_ticks = 0;
+      pit_program (0x34, tick_count);
+      catch_up (skipped);
+    }
+
   ticks++;
   thread_tick ();
+  wake_sleepers ();
+}
+
+/* Wakes up the threads whose sleep is over. */
+static void
+wake_sleepers (void)
+{
+  while (!list_empty (&sleep_list))
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wakeup_tick > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      thread_unblock (t);
+    }
+}
+
+/* Adds SKIPPED ticks, spent idle with the periodic interrupt
+   stopped, to the tick count. */
+static void
+catch_up (int64_t skipped)
+{
+  ticks += skipped;
+  thread_idle_ticks (skipped);
+  wake_sleepers ();
+}
+
+/* Writes CONTROL to the 8254 control register, then loads COUNT
+   into counter 0, LSB then MSB. */
+static void
+pit_program (uint8_t control, uint16_t count)
+{
+  outb (0x43, control);
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Returns true if thread A wakes up before thread B. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+  return a->wakeup_tick < b->wakeup_tick;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
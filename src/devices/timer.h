@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 void timer_init (uint16_t timer_freq);
@@ -17,6 +18,11 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 /* used by thread test programs */
 extern uint16_t TIMER_FREQ;
 
@@ -0,0 +1,448 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.
+
+   Keeps up to CACHE_SIZE sectors of the file system disk in
+   memory.  All sector I/O of inode.c goes through here, and
+   since directories and the free map are stored in ordinary
+   files, so does theirs.  Repeated accesses to a hot sector,
+   e.g. a directory block, therefore never reach the disk.
+
+   Modified sectors are only marked dirty.  They are written
+   back when their entry is evicted, or by cache_flush(), which
+   the write-behind thread calls every WRITE_BEHIND_MSECS
+   milliseconds and filesys_done() calls at power off.
+
+   Entries are replaced with the clock algorithm: the clock hand
+   sweeps over the entries, giving every recently accessed entry
+   a second chance, and evicts the first one that has not been
+   accessed since the hand last passed it.
+
+   Sequential reads are sped up by a read-ahead thread.
+   inode_read_ahead_at() passes it the sector that will most likely
+   be read next through cache_readahead(), and the thread reads that
+   sector into the cache while the reader is still busy copying
+   the current chunk. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Milliseconds between two flushes by the write-behind thread. */
+#define WRITE_BEHIND_MSECS 1000
+
+/* A cached sector. */
+struct cache_entry
+  {
+    /* Protected by cache_lock. */
+    disk_sector_t sector;               /* Cached sector, if in_use. */
+    bool in_use;                        /* Does this entry hold a sector? */
+    int pin_cnt;                        /* Threads using this entry. */
+
+    /* Protected by the entry's lock, or by cache_lock while
+       pin_cnt is 0. */
+    struct lock lock;                   /* Serializes access to data. */
+    bool dirty;                         /* Modified since read from disk? */
+    bool accessed;                      /* Accessed since clock passed? */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;          /* Protects sector mapping. */
+static struct condition cache_unpinned; /* Signaled when pin_cnt drops. */
+static size_t clock_hand;               /* Next entry to consider. */
+
+/* Read-ahead requests.
+   A ring buffer of sectors waiting to be read in.  Requests that
+   arrive while it is full are dropped: read-ahead is only a
+   hint. */
+#define READAHEAD_SIZE 16
+static disk_sector_t readahead_queue[READAHEAD_SIZE];
+static size_t readahead_head;           /* Index of oldest request. */
+static size_t readahead_cnt;            /* Number of queued requests. */
+static struct lock readahead_lock;      /* Protects the queue. */
+static struct condition readahead_cond; /* Signaled on new request. */
+static long long readahead_requests;    /* Calls to cache_readahead(). */
+
+static struct cache_entry *cache_get (disk_sector_t, bool load);
+static void cache_put (struct cache_entry *);
+static struct cache_entry *lookup (disk_sector_t);
+static struct cache_entry *evict (void);
+static void write_run (struct cache_entry **, size_t cnt);
+static thread_func readahead_daemon NO_RETURN;
+static thread_func flush_daemon NO_RETURN;
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&cache_unpinned);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      e->in_use = false;
+      e->pin_cnt = 0;
+      lock_init (&e->lock);
+      e->dirty = false;
+      e->accessed = false;
+    }
+  clock_hand = 0;
+
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  readahead_head = readahead_cnt = 0;
+  if (thread_create_daemon ("read-ahead", PRI_DEFAULT,
+                            readahead_daemon, NULL) == TID_ERROR)
+    PANIC ("can't create read-ahead thread");
+  if (thread_create_daemon ("write-behind", PRI_DEFAULT,
+                            flush_daemon, NULL) == TID_ERROR)
+    PANIC ("can't create write-behind thread");
+}
+
+/* Reads SIZE bytes starting at byte OFS of SECTOR into
+   BUFFER. */
+void
+cache_read (disk_sector_t sector, void *buffer, off_t ofs, off_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  e->accessed = true;
+  cache_put (e);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at byte
+   OFS of the sector.  The write reaches the disk when the
+   sector is evicted or flushed. */
+void
+cache_write (disk_sector_t sector, const void *buffer, off_t ofs, off_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  /* There is no need to read the old contents of the sector
+     from disk if all of it is overwritten. */
+  e = cache_get (sector, ofs > 0 || size < DISK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  e->accessed = true;
+  cache_put (e);
+}
+
+/* Reads the CNT adjacent sectors starting at SECTOR into
+   BUFFER.  Cached sectors are copied from the cache.  Each run
+   of uncached sectors is read from disk with a single
+   multi-sector transfer, straight into BUFFER, without going
+   through the cache, so that one big read does not evict
+   everything else.
+
+   A sector that is not cached has no newer copy than the one on
+   disk, because evict() writes dirty sectors back before it lets
+   go of them.  Concurrent writes to the same file are excluded by
+   inode_read_at(). */
+void
+cache_read_multi (disk_sector_t sector, size_t cnt, void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  size_t i = 0;
+
+  while (i < cnt)
+    {
+      size_t run;
+
+      lock_acquire (&cache_lock);
+      if (lookup (sector + i) != NULL)
+        {
+          lock_release (&cache_lock);
+          cache_read (sector + i, buffer + i * DISK_SECTOR_SIZE,
+                      0, DISK_SECTOR_SIZE);
+          i++;
+          continue;
+        }
+      for (run = 1; i + run < cnt; run++)
+        if (lookup (sector + i + run) != NULL)
+          break;
+      lock_release (&cache_lock);
+
+      disk_read_multi (filesys_disk, sector + i, run,
+                       buffer + i * DISK_SECTOR_SIZE);
+      i += run;
+    }
+}
+
+/* Writes every dirty sector in the cache to disk.
+   The sectors are written in ascending order, and each run of
+   adjacent dirty sectors is written as one batch. */
+void
+cache_flush (void)
+{
+  struct cache_entry *dirty[CACHE_SIZE];
+  size_t dirty_cnt = 0;
+  size_t i, j;
+
+  /* Pin the dirty entries, sorted by sector.  Peeking at `dirty'
+     without the entries' locks is fine: an entry that becomes
+     dirty behind our back is written by the next flush. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (!e->in_use || !e->dirty)
+        continue;
+
+      e->pin_cnt++;
+      for (j = dirty_cnt++; j > 0 && dirty[j - 1]->sector > e->sector; j--)
+        dirty[j] = dirty[j - 1];
+      dirty[j] = e;
+    }
+  lock_release (&cache_lock);
+
+  /* Write them out a run at a time. */
+  for (i = 0; i < dirty_cnt; i = j)
+    {
+      for (j = i + 1; j < dirty_cnt; j++)
+        if (dirty[j]->sector != dirty[j - 1]->sector + 1)
+          break;
+      write_run (dirty + i, j - i);
+    }
+}
+
+/* Asks the read-ahead thread to read SECTOR into the cache in
+   the background.  Never blocks on disk I/O. */
+void
+cache_readahead (disk_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  readahead_requests++;
+  if (readahead_cnt < READAHEAD_SIZE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt) % READAHEAD_SIZE]
+        = sector;
+      readahead_cnt++;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld read-ahead requests\n", readahead_requests);
+}
+
+/* Read-ahead thread.  Reads the sectors queued by
+   cache_readahead() into the cache, oldest first. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  DEBUG_thread_daemon ();
+
+  for (;;)
+    {
+      disk_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      /* Read SECTOR in, unless it is already cached. */
+      cache_put (cache_get (sector, true));
+    }
+}
+
+/* Write-behind thread.  Flushes the free map and the cache every
+   WRITE_BEHIND_MSECS milliseconds, so that dirty sectors do not
+   stay in memory indefinitely. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  DEBUG_thread_daemon ();
+
+  for (;;)
+    {
+      timer_msleep (WRITE_BEHIND_MSECS);
+      free_map_sync ();
+      cache_flush ();
+    }
+}
+
+/* Writes the CNT entries in ENTRIES, which must be pinned and
+   hold adjacent sectors in ascending order, to disk and releases
+   them.  The run is gathered into a temporary buffer and written
+   by a single multi-sector transfer.  If no buffer can be
+   allocated, the sectors are written one at a time instead.
+   Every entry stays locked until the whole run has been
+   written. */
+static void
+write_run (struct cache_entry **entries, size_t cnt)
+{
+  uint8_t *buffer;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    lock_acquire (&entries[i]->lock);
+
+  buffer = cnt > 1 ? malloc (cnt * DISK_SECTOR_SIZE) : NULL;
+  if (buffer != NULL)
+    {
+      for (i = 0; i < cnt; i++)
+        memcpy (buffer + i * DISK_SECTOR_SIZE, entries[i]->data,
+                DISK_SECTOR_SIZE);
+      disk_write_multi (filesys_disk, entries[0]->sector, cnt, buffer);
+      free (buffer);
+    }
+  else
+    {
+      for (i = 0; i < cnt; i++)
+        disk_write (filesys_disk, entries[i]->sector, entries[i]->data);
+    }
+
+  for (i = 0; i < cnt; i++)
+    entries[i]->dirty = false;
+
+  for (i = 0; i < cnt; i++)
+    cache_put (entries[i]);
+}
+
+/* Returns the entry that holds SECTOR, pinned and with its lock
+   held.  If SECTOR is not cached, another entry is evicted to
+   make room for it, and SECTOR is read into it unless LOAD is
+   false, in which case the caller must overwrite the entire
+   sector.  Release the entry with cache_put(). */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool load)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          /* Cache hit.  The entry cannot be evicted while it is
+             pinned, so it is safe to wait for its lock without
+             holding cache_lock. */
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          lock_acquire (&e->lock);
+          return e;
+        }
+
+      e = evict ();
+      if (e != NULL)
+        break;
+
+      /* Every entry is in use.  Wait for one to be released and
+         look again, since SECTOR may have been read in while we
+         waited. */
+      cond_wait (&cache_unpinned, &cache_lock);
+    }
+
+  /* Cache miss.  Claim the free entry for SECTOR before
+     releasing cache_lock, so that concurrent lookups of SECTOR
+     find it and wait on its lock until it has been read in. */
+  e->sector = sector;
+  e->in_use = true;
+  e->pin_cnt = 1;
+  lock_acquire (&e->lock);
+  lock_release (&cache_lock);
+
+  if (load)
+    disk_read (filesys_disk, sector, e->data);
+  e->dirty = false;
+  e->accessed = false;
+  return e;
+}
+
+/* Releases entry E, which was obtained from cache_get(). */
+static void
+cache_put (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_signal (&cache_unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry that holds SECTOR, or a null pointer if
+   SECTOR is not cached.  cache_lock must be held. */
+static struct cache_entry *
+lookup (disk_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Selects an entry to replace using the clock algorithm, writes
+   it back if it is dirty, and returns it marked as unused.
+   Returns a null pointer if every entry is pinned.
+   cache_lock must be held.
+
+   The write-back is done while holding cache_lock.  Otherwise
+   another thread could miss on the old sector and read a stale
+   copy of it from disk before the write-back was complete. */
+static struct cache_entry *
+evict (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two sweeps are enough: the first one clears the accessed
+     bit of every unpinned entry. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->in_use)
+        return e;
+      if (e->pin_cnt > 0)
+        continue;
+      if (e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+
+      if (e->dirty)
+        {
+          disk_write (filesys_disk, e->sector, e->data);
+          e->dirty = false;
+        }
+      e->in_use = false;
+      return e;
+    }
+  return NULL;
+}
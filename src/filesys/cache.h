@@ -0,0 +1,16 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "devices/disk.h"
+
+void cache_init (void);
+void cache_read (disk_sector_t, void *, off_t ofs, off_t size);
+void cache_write (disk_sector_t, const void *, off_t ofs, off_t size);
+void cache_read_multi (disk_sector_t, size_t cnt, void *);
+void cache_readahead (disk_sector_t);
+void cache_flush (void);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
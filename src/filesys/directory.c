@@ -1,11 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 
 
@@ -24,11 +26,60 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* In-memory index of a directory's entries.
+
+   Finding a name by reading the directory's entries one by one
+   costs a pass over the whole directory, so the first access to
+   a directory builds an index of it that maps every name to the
+   entry's offset and also records the free slots.  Indexes are
+   keyed by the directory's inode sector and outlive the `struct
+   dir's and inodes of the directory, since filesys_open() and
+   friends open and close the root directory on every call.
+   dir_add() and dir_remove() keep the index in step with the
+   entries on disk.  If memory runs out while updating an index,
+   the index is dropped and rebuilt by the next access. */
+struct dir_index
+  {
+    struct list_elem elem;              /* Element in dir_indexes. */
+    disk_sector_t sector;               /* Directory's inode sector. */
+    struct hash names;                  /* Entries in use, by name. */
+    struct list free_slots;             /* Offsets of unused entries. */
+    off_t end;                          /* Offset just past last entry. */
+  };
+
+/* An entry in use, in a dir_index's NAMES. */
+struct index_entry
+  {
+    struct hash_elem elem;              /* Element in NAMES. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    disk_sector_t inode_sector;         /* Sector number of header. */
+    off_t ofs;                          /* Offset of the dir_entry. */
+  };
+
+/* An unused entry, in a dir_index's FREE_SLOTS. */
+struct free_slot
+  {
+    struct list_elem elem;              /* Element in FREE_SLOTS. */
+    off_t ofs;                          /* Offset of the dir_entry. */
+  };
+
+/* Directory indexes built so far. */
+static struct list dir_indexes;
+
+static void drop_index (disk_sector_t);
+
 struct lock dir_lock;
 
+/* Cache of `struct dir's. */
+static struct kmem_cache *dir_cache;
+
 void dir_lock_init()
 {
   lock_init(&dir_lock);
+  list_init (&dir_indexes);
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
+  if (dir_cache == NULL)
+    PANIC ("dir cache creation failed");
 }
 
 
@@ -37,6 +88,11 @@ void dir_lock_init()
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt)
 {
+  /* Forget any index of a directory that used to be there. */
+  lock_acquire(&dir_lock);
+  drop_index (sector);
+  lock_release(&dir_lock);
+
   return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -45,7 +101,7 @@ dir_create (disk_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode)
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = inode != NULL ? kmem_cache_alloc (dir_cache) : NULL;
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -55,7 +111,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL;
     }
 }
@@ -83,7 +139,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -94,21 +150,191 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns a hash value for index entry E. */
+static unsigned
+index_entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct index_entry, elem)->name);
+}
+
+/* Returns true if index entry A's name precedes B's. */
+static bool
+index_entry_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct index_entry, elem)->name,
+                 hash_entry (b, struct index_entry, elem)->name) < 0;
+}
+
+/* Frees index entry E.  Used as a hash_action_func. */
+static void
+index_entry_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct index_entry, elem));
+}
+
+/* Adds an entry for NAME, with the given INODE_SECTOR and offset
+   OFS, to INDEX.  Returns false if memory is exhausted. */
+static bool
+index_add (struct dir_index *index, const char *name,
+           disk_sector_t inode_sector, off_t ofs)
+{
+  struct index_entry *ie = malloc (sizeof *ie);
+  if (ie == NULL)
+    return false;
+  strlcpy (ie->name, name, sizeof ie->name);
+  ie->inode_sector = inode_sector;
+  ie->ofs = ofs;
+  hash_insert (&index->names, &ie->elem);
+  return true;
+}
+
+/* Records that the entry at offset OFS in INDEX is unused.
+   Returns false if memory is exhausted. */
+static bool
+index_add_free (struct dir_index *index, off_t ofs)
+{
+  struct free_slot *slot = malloc (sizeof *slot);
+  if (slot == NULL)
+    return false;
+  slot->ofs = ofs;
+  list_push_back (&index->free_slots, &slot->elem);
+  return true;
+}
+
+/* Removes INDEX from dir_indexes and frees it. */
+static void
+index_destroy (struct dir_index *index)
+{
+  list_remove (&index->elem);
+  hash_destroy (&index->names, index_entry_free);
+  while (!list_empty (&index->free_slots))
+    free (list_entry (list_pop_front (&index->free_slots),
+                      struct free_slot, elem));
+  free (index);
+}
+
+/* Returns the index of DIR, building it if necessary.
+   Returns a null pointer if memory is exhausted.
+   The caller must hold dir_lock. */
+static struct dir_index *
+get_index (const struct dir *dir)
+{
+  disk_sector_t sector = inode_get_inumber (dir->inode);
+  struct dir_index *index;
+  struct dir_entry e;
+  struct list_elem *le;
+  off_t ofs;
+
+  for (le = list_begin (&dir_indexes); le != list_end (&dir_indexes);
+       le = list_next (le))
+    {
+      index = list_entry (le, struct dir_index, elem);
+      if (index->sector == sector)
+        return index;
+    }
+
+  index = malloc (sizeof *index);
+  if (index == NULL)
+    return NULL;
+  if (!hash_init (&index->names, index_entry_hash, index_entry_less, NULL))
+    {
+      free (index);
+      return NULL;
+    }
+  list_init (&index->free_slots);
+  index->sector = sector;
+  list_push_front (&dir_indexes, &index->elem);
+
+  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use ? !index_add (index, e.name, e.inode_sector, ofs)
+                 : !index_add_free (index, ofs))
+      {
+        index_destroy (index);
+        return NULL;
+      }
+  index->end = ofs;
+  return index;
+}
+
+/* Forgets the index of the directory whose inode is in SECTOR,
+   if there is one.  It is rebuilt the next time it is needed. */
+static void
+drop_index (disk_sector_t sector)
+{
+  struct list_elem *le;
+
+  for (le = list_begin (&dir_indexes); le != list_end (&dir_indexes);
+       le = list_next (le))
+    {
+      struct dir_index *index = list_entry (le, struct dir_index, elem);
+      if (index->sector == sector)
+        {
+          index_destroy (index);
+          return;
+        }
+    }
+}
+
+/* Frees all directory indexes.  Called when the file system is
+   shut down. */
+void
+dir_indexes_destroy (void)
+{
+  lock_acquire (&dir_lock);
+  while (!list_empty (&dir_indexes))
+    index_destroy (list_entry (list_front (&dir_indexes),
+                               struct dir_index, elem));
+  lock_release (&dir_lock);
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Uses DIR's index if one can be built, and otherwise falls back
+   to reading the entries one by one.
+   The caller must hold dir_lock. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp)
 {
+  struct dir_index *index;
   struct dir_entry e;
   size_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  index = get_index (dir);
+  if (index != NULL)
+    {
+      struct index_entry key;
+      struct hash_elem *he;
+
+      if (strlen (name) > NAME_MAX)
+        return false;
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_find (&index->names, &key.elem);
+      if (he == NULL)
+        return false;
+      if (ep != NULL || ofsp != NULL)
+        {
+          struct index_entry *ie = hash_entry (he, struct index_entry, elem);
+          if (ep != NULL)
+            {
+              ep->inode_sector = ie->inode_sector;
+              strlcpy (ep->name, ie->name, sizeof ep->name);
+              ep->in_use = true;
+            }
+          if (ofsp != NULL)
+            *ofsp = ie->ofs;
+        }
+      return true;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && !strcmp (name, e.name))
@@ -155,6 +381,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
 {
+  struct dir_index *index;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -179,10 +406,16 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e)
-    if (!e.in_use)
-      break;
+  index = get_index (dir);
+  if (index != NULL)
+    ofs = (list_empty (&index->free_slots) ? index->end
+           : list_entry (list_front (&index->free_slots),
+                         struct free_slot, elem)->ofs);
+  else
+    for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e)
+      if (!e.in_use)
+        break;
 
   /* Write slot. */
   e.in_use = true;
@@ -190,6 +423,18 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+  /* Update the index. */
+  if (success && index != NULL)
+    {
+      if (!index_add (index, name, inode_sector, ofs))
+        drop_index (index->sector);
+      else if (ofs == index->end)
+        index->end += sizeof e;
+      else
+        free (list_entry (list_pop_front (&index->free_slots),
+                          struct free_slot, elem));
+    }
+
  done:
   lock_release(&dir_lock);
   return success;
@@ -201,6 +446,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name)
 {
+  struct dir_index *index;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -224,6 +470,21 @@ dir_remove (struct dir *dir, const char *name)
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
     goto done;
 
+  /* Update the index. */
+  index = get_index (dir);
+  if (index != NULL)
+    {
+      struct index_entry key;
+      struct hash_elem *he;
+
+      strlcpy (key.name, name, sizeof key.name);
+      he = hash_delete (&index->names, &key.elem);
+      if (he != NULL)
+        index_entry_free (he, NULL);
+      if (!index_add_free (index, ofs))
+        drop_index (index->sector);
+    }
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
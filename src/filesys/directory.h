@@ -14,6 +14,7 @@
 struct inode;
 
 void dir_lock_init(void);
+void dir_indexes_destroy (void);
 
 
 /* Opening and closing directories. */
@@ -1,33 +1,48 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
+    off_t read_end;             /* Position after the last file_read(). */
+    bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+/* Cache of `struct file's. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void)
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+  if (file_cache == NULL)
+    PANIC ("file cache creation failed");
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode)
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = inode != NULL ? kmem_cache_alloc (file_cache) : NULL;
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
-
+      file->read_end = 0;
+      file->deny_write = false;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL;
     }
 }
@@ -46,8 +61,9 @@ file_close (struct file *file)
 {
   if (file != NULL)
     {
+      file_allow_write (file);
       inode_close (file->inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
     }
 }
 
@@ -62,12 +78,19 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   If the read continues where the previous one on FILE ended,
+   the next sector is read ahead.  Each opener tracks this on
+   its own, so readers sharing an inode do not disturb each
+   other. */
 off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  bool sequential = file->pos == file->read_end;
+  off_t bytes_read = inode_read_ahead_at (file->inode, buffer, size,
+                                          file->pos, sequential);
   file->pos += bytes_read;
+  file->read_end = file->pos;
   return bytes_read;
 }
 
@@ -85,9 +108,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size)
@@ -100,9 +122,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -111,6 +132,32 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Prevents write operations on FILE's underlying inode
+   until file_allow_write() is called or FILE is closed. */
+void
+file_deny_write (struct file *file)
+{
+  ASSERT (file != NULL);
+  if (!file->deny_write)
+    {
+      file->deny_write = true;
+      inode_deny_write (file->inode);
+    }
+}
+
+/* Re-enables write operations on FILE's underlying inode.
+   (Writes might still be denied by some other file that has the
+   same inode open.) */
+void
+file_allow_write (struct file *file)
+{
+  ASSERT (file != NULL);
+  if (file->deny_write)
+    {
+      file->deny_write = false;
+      inode_allow_write (file->inode);
+    }
+}
 
 /* Returns the size of FILE in bytes. */
 off_t
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -23,8 +24,10 @@ filesys_init (bool format)
   if (filesys_disk == NULL)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
-  inode_init ();
   free_map_init ();
+  cache_init ();
+  inode_init ();
+  file_init ();
 
   dir_lock_init();
 
@@ -41,6 +44,9 @@ filesys_done (void)
 {
   free_map_close ();
   free_map_destroy ();
+  cache_flush ();
+  dir_indexes_destroy ();
+  inode_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -1,26 +1,94 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
 
-// static struct lock free_map_lock;
+/* Free map.
+
+   The bitmap, one bit per disk sector, is what is stored on
+   disk.  Allocation does not scan it, though: the free sectors
+   are also kept in memory as extents, i.e. maximal runs of free
+   sectors.  Each extent is in the size bucket for its length,
+   where bucket I holds the extents of 2**I to 2**(I+1) - 1
+   sectors, and in two hash tables keyed by its first sector and
+   by the sector just past its end, which let a released run be
+   merged with its neighbors in constant time.
+
+   Successive allocations are carved from the same extent as long
+   as it is large enough, so that a growing file gets adjacent
+   sectors.  Otherwise an extent from the largest nonempty bucket
+   is used.
+
+   Changes to the bitmap are not written right away.  Instead,
+   the sectors of the free map file that hold changed bits are
+   marked dirty, and only those are written by free_map_sync(),
+   which the write-behind thread calls periodically and
+   free_map_close() calls at shutdown. */
+
+/* A run of free sectors. */
+struct extent
+{
+  disk_sector_t start;         /* First free sector. */
+  size_t cnt;                  /* Number of free sectors. */
+  struct list_elem list_elem;  /* Element in size bucket. */
+  struct hash_elem start_elem; /* Element in extents_by_start. */
+  struct hash_elem end_elem;   /* Element in extents_by_end. */
+};
+
+/* Number of size buckets. */
+#define BUCKET_CNT 32
+
+/* Number of bitmap bits stored in each sector of the free map
+   file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
 static struct file *free_map_file; /* Free map file. */
 static struct bitmap *free_map;    /* Free map, one bit per disk sector. */
+static struct bitmap *dirty_map;   /* One bit per free map file sector. */
+
+static struct list buckets[BUCKET_CNT]; /* Extents by size. */
+static struct hash extents_by_start;    /* Extents by first sector. */
+static struct hash extents_by_end;      /* Extents by end sector. */
+static struct extent *cursor;           /* Extent allocated from last. */
 
 static struct lock free_map_lock;
 
+static void build_extents(void);
+static void insert_extent(struct extent *);
+static void remove_extent(struct extent *);
+static void mark_dirty(disk_sector_t, size_t cnt);
+static hash_hash_func extent_start_hash, extent_end_hash;
+static hash_less_func extent_start_less, extent_end_less;
+
 /* Initializes the free map. */
 void free_map_init(void)
 {
+  size_t i;
+
+  lock_init(&free_map_lock);
   free_map = bitmap_create(disk_size(filesys_disk));
   if (free_map == NULL)
     PANIC("bitmap creation failed--disk is too large");
+  dirty_map = bitmap_create(DIV_ROUND_UP(bitmap_size(free_map),
+                                         BITS_PER_SECTOR));
+  if (dirty_map == NULL)
+    PANIC("dirty map creation failed");
   bitmap_mark(free_map, FREE_MAP_SECTOR);
   bitmap_mark(free_map, ROOT_DIR_SECTOR);
-  lock_init(&free_map_lock);
+
+  for (i = 0; i < BUCKET_CNT; i++)
+    list_init(&buckets[i]);
+  if (!hash_init(&extents_by_start, extent_start_hash, extent_start_less, NULL)
+      || !hash_init(&extents_by_end, extent_end_hash, extent_end_less, NULL))
+    PANIC("free extent table creation failed");
+  build_extents();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -29,26 +97,141 @@ void free_map_init(void)
    available. */
 bool free_map_allocate(size_t cnt, disk_sector_t *sectorp)
 {
-  disk_sector_t sector;
+  struct extent *e = NULL;
+
+  ASSERT(cnt > 0);
+
   lock_acquire(&free_map_lock);
-  sector = bitmap_scan_and_flip(free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR && free_map_file != NULL && !bitmap_write(free_map, free_map_file))
+  if (cursor != NULL && cursor->cnt >= cnt)
+    e = cursor;
+  else
   {
-    bitmap_set_multiple(free_map, sector, cnt, false);
-    sector = BITMAP_ERROR;
+    /* Only the largest nonempty bucket can hold an extent of at
+       least CNT sectors if any does, since every extent in a
+       smaller bucket is shorter than every extent in it. */
+    int b;
+    for (b = BUCKET_CNT - 1; b >= 0; b--)
+      if (!list_empty(&buckets[b]))
+      {
+        struct list_elem *le;
+        for (le = list_begin(&buckets[b]); le != list_end(&buckets[b]);
+             le = list_next(le))
+        {
+          struct extent *candidate = list_entry(le, struct extent, list_elem);
+          if (candidate->cnt >= cnt)
+          {
+            e = candidate;
+            break;
+          }
+        }
+        break;
+      }
+  }
+
+  if (e != NULL)
+  {
+    *sectorp = e->start;
+    ASSERT(bitmap_none(free_map, e->start, cnt));
+    bitmap_set_multiple(free_map, e->start, cnt, true);
+    mark_dirty(e->start, cnt);
+
+    /* Carve the sectors off the front of the extent. */
+    remove_extent(e);
+    e->start += cnt;
+    e->cnt -= cnt;
+    if (e->cnt > 0)
+    {
+      insert_extent(e);
+      cursor = e;
+    }
+    else
+    {
+      free(e);
+      cursor = NULL;
+    }
   }
   lock_release(&free_map_lock);
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  return e != NULL;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void free_map_release(disk_sector_t sector, size_t cnt)
 {
+  struct extent key, *prev = NULL, *next = NULL;
+  struct hash_elem *he;
+
+  lock_acquire(&free_map_lock);
   ASSERT(bitmap_all(free_map, sector, cnt));
   bitmap_set_multiple(free_map, sector, cnt, false);
-  bitmap_write(free_map, free_map_file);
+  mark_dirty(sector, cnt);
+
+  /* Find the free extents that end just before and start just
+     after the released sectors. */
+  key.start = sector;
+  key.cnt = 0;
+  he = hash_find(&extents_by_end, &key.end_elem);
+  if (he != NULL)
+    prev = hash_entry(he, struct extent, end_elem);
+  key.start = sector + cnt;
+  he = hash_find(&extents_by_start, &key.start_elem);
+  if (he != NULL)
+    next = hash_entry(he, struct extent, start_elem);
+
+  if (prev != NULL)
+  {
+    remove_extent(prev);
+    prev->cnt += cnt;
+    if (next != NULL)
+    {
+      remove_extent(next);
+      prev->cnt += next->cnt;
+      if (cursor == next)
+        cursor = prev;
+      free(next);
+    }
+    insert_extent(prev);
+  }
+  else if (next != NULL)
+  {
+    remove_extent(next);
+    next->start = sector;
+    next->cnt += cnt;
+    insert_extent(next);
+  }
+  else
+  {
+    /* If no memory is available the sectors are still free in
+       the bitmap, so they become allocatable again the next time
+       the free map is read from disk. */
+    struct extent *e = malloc(sizeof *e);
+    if (e != NULL)
+    {
+      e->start = sector;
+      e->cnt = cnt;
+      insert_extent(e);
+    }
+  }
+  lock_release(&free_map_lock);
+}
+
+/* Writes the sectors of the free map file that hold bits changed
+   since the last call to disk.  Does nothing while the free map
+   file is not open. */
+void free_map_sync(void)
+{
+  size_t i;
+
+  lock_acquire(&free_map_lock);
+  if (free_map_file != NULL && dirty_map != NULL)
+    for (i = 0; i < bitmap_size(dirty_map); i++)
+      if (bitmap_test(dirty_map, i))
+      {
+        if (!bitmap_write_range(free_map, free_map_file,
+                                i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE))
+          PANIC("can't write free map");
+        bitmap_reset(dirty_map, i);
+      }
+  lock_release(&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -59,18 +242,36 @@ void free_map_open(void)
     PANIC("can't open free map");
   if (!bitmap_read(free_map, free_map_file))
     PANIC("can't read free map");
+  bitmap_set_all(dirty_map, false);
+  build_extents();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void free_map_close(void)
 {
+  free_map_sync();
+  lock_acquire(&free_map_lock);
   file_close(free_map_file);
+  free_map_file = NULL;
+  lock_release(&free_map_lock);
+}
+
+/* Frees an extent.  Used as a hash_action_func. */
+static void free_extent(struct hash_elem *e, void *aux UNUSED)
+{
+  free(hash_entry(e, struct extent, start_elem));
 }
 
 /* Deallocates the free-map before system shutdown. */
 void free_map_destroy(void)
 {
+  lock_acquire(&free_map_lock);
+  hash_destroy(&extents_by_end, NULL);
+  hash_destroy(&extents_by_start, free_extent);
+  bitmap_destroy(dirty_map);
   bitmap_destroy(free_map);
+  dirty_map = free_map = NULL;
+  lock_release(&free_map_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -87,4 +288,103 @@ void free_map_create(void)
     PANIC("can't open free map");
   if (!bitmap_write(free_map, free_map_file))
     PANIC("can't write free map");
+  bitmap_set_all(dirty_map, false);
+}
+
+/* Discards the free extents and rebuilds them from the free
+   map. */
+static void build_extents(void)
+{
+  size_t i;
+  size_t start = 0;
+
+  hash_clear(&extents_by_end, NULL);
+  hash_clear(&extents_by_start, free_extent);
+  for (i = 0; i < BUCKET_CNT; i++)
+    list_init(&buckets[i]);
+  cursor = NULL;
+
+  while ((start = bitmap_scan(free_map, start, 1, false)) != BITMAP_ERROR)
+  {
+    size_t end = bitmap_scan(free_map, start, 1, true);
+    struct extent *e = malloc(sizeof *e);
+    if (end == BITMAP_ERROR)
+      end = bitmap_size(free_map);
+    if (e == NULL)
+      PANIC("out of memory building free extents");
+    e->start = start;
+    e->cnt = end - start;
+    insert_extent(e);
+    start = end;
+  }
+}
+
+/* Returns the size bucket for an extent of CNT sectors. */
+static struct list *bucket_of(size_t cnt)
+{
+  int b = 0;
+
+  ASSERT(cnt > 0);
+  while (cnt >>= 1)
+    b++;
+  return &buckets[b];
+}
+
+/* Adds E to its bucket and to the hash tables. */
+static void insert_extent(struct extent *e)
+{
+  list_push_front(bucket_of(e->cnt), &e->list_elem);
+  hash_insert(&extents_by_start, &e->start_elem);
+  hash_insert(&extents_by_end, &e->end_elem);
+}
+
+/* Removes E from its bucket and from the hash tables. */
+static void remove_extent(struct extent *e)
+{
+  list_remove(&e->list_elem);
+  hash_delete(&extents_by_start, &e->start_elem);
+  hash_delete(&extents_by_end, &e->end_elem);
+}
+
+/* Marks the free map file sectors that hold the bits for the CNT
+   sectors starting at SECTOR as dirty. */
+static void mark_dirty(disk_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+  bitmap_set_multiple(dirty_map, first, last - first + 1, true);
+}
+
+/* Returns a hash value for the first sector of extent E. */
+static unsigned extent_start_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int(hash_entry(e, struct extent, start_elem)->start);
+}
+
+/* Returns true if extent A starts before extent B. */
+static bool extent_start_less(const struct hash_elem *a,
+                              const struct hash_elem *b, void *aux UNUSED)
+{
+  return (hash_entry(a, struct extent, start_elem)->start
+          < hash_entry(b, struct extent, start_elem)->start);
+}
+
+/* Returns the sector just past the end of extent E. */
+static disk_sector_t extent_end(const struct hash_elem *e)
+{
+  const struct extent *x = hash_entry(e, struct extent, end_elem);
+  return x->start + x->cnt;
+}
+
+/* Returns a hash value for the end sector of extent E. */
+static unsigned extent_end_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int(extent_end(e));
+}
+
+/* Returns true if extent A ends before extent B. */
+static bool extent_end_less(const struct hash_elem *a,
+                            const struct hash_elem *b, void *aux UNUSED)
+{
+  return extent_end(a) < extent_end(b);
 }
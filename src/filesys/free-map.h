@@ -14,5 +14,6 @@ void free_map_destroy (void);
 
 bool free_map_allocate (size_t, disk_sector_t *);
 void free_map_release (disk_sector_t, size_t);
+void free_map_sync (void);
 
 #endif /* filesys/free-map.h */
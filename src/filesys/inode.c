@@ -1,25 +1,36 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of data sector pointers stored in the inode itself. */
+#define DIRECT_CNT 124
+
+/* Number of sector pointers that fit in an index sector. */
+#define PTRS_PER_SECTOR ((size_t) (DISK_SECTOR_SIZE / sizeof (disk_sector_t)))
+
 /* On-disk inode.
-   Must be exactly DISK_SECTOR_SIZE bytes long. */
+   Must be exactly DISK_SECTOR_SIZE bytes long.
+   A sector pointer of 0 means "not allocated": sector 0 always
+   holds the free map inode, so it is never a data sector. */
 struct inode_disk
   {
-    disk_sector_t start;                /* First data sector. */
+    disk_sector_t direct[DIRECT_CNT];   /* Data sectors. */
+    disk_sector_t indirect;             /* Sector of data sector ptrs. */
+    disk_sector_t doubly_indirect;      /* Sector of indirect sector ptrs. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -30,47 +41,230 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* The part of an in-memory inode by which it is found in the
+   open inode table, so that a lookup key is only this big. */
+struct inode_key
+  {
+    struct hash_elem elem;              /* Element in open inode table. */
+    disk_sector_t sector;               /* Sector number of disk location. */
+  };
+
 /* In-memory inode. */
 struct inode
   {
-    struct list_elem elem;              /* Element in inode list. */
-    disk_sector_t sector;               /* Sector number of disk location. */
+    struct inode_key key;               /* Open inode table entry. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
+    int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
 
     struct lock metadata_lock;
-    bool writing;
-    struct condition write_cond;
-    int read_cnt;
+    struct rwlock rw;                   /* Readers-writer lock on data. */
   };
 
 
-/* Returns the disk sector that contains byte offset POS within
-   INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
-static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+/* Allocates a sector, zeroes it, and stores its number in
+   *SECTORP.  Returns true if successful, false if the disk is
+   full. */
+static bool
+allocate_zeroed (disk_sector_t *sectorp)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / DISK_SECTOR_SIZE;
+  static char zeros[DISK_SECTOR_SIZE];
+
+  if (!free_map_allocate (1, sectorp))
+    return false;
+  cache_write (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+  return true;
+}
+
+/* Stores in *SECTORP entry IDX of index sector BLOCK.  If the
+   entry is unallocated and ALLOCATE is true, allocates a zeroed
+   sector for it first.  Returns false if the entry is (still)
+   unallocated. */
+static bool
+index_lookup (disk_sector_t block, size_t idx, bool allocate,
+              disk_sector_t *sectorp)
+{
+  disk_sector_t sector;
+
+  cache_read (block, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0)
+    {
+      if (!allocate || !allocate_zeroed (&sector))
+        return false;
+      cache_write (block, &sector, idx * sizeof sector, sizeof sector);
+    }
+  *sectorp = sector;
+  return true;
+}
+
+/* Stores in *SECTORP the disk sector that holds data sector IDX
+   of DISK_INODE, whose own location is INODE_SECTOR.
+   If that sector, or an index sector leading to it, is not
+   allocated yet and ALLOCATE is true, allocates it zero-filled;
+   changes to DISK_INODE itself are written back to INODE_SECTOR.
+   Returns false if the sector is not allocated (a hole, which
+   reads as zeros), if IDX is beyond the largest possible file,
+   or if the disk is full. */
+static bool
+lookup_sector (disk_sector_t inode_sector, struct inode_disk *disk_inode,
+               size_t idx, bool allocate, disk_sector_t *sectorp)
+{
+  disk_sector_t *root;
+  disk_sector_t sector;
+  int levels;
+
+  if (idx < DIRECT_CNT)
+    {
+      root = &disk_inode->direct[idx];
+      levels = 0;
+    }
+  else if ((idx -= DIRECT_CNT) < PTRS_PER_SECTOR)
+    {
+      root = &disk_inode->indirect;
+      levels = 1;
+    }
+  else if ((idx -= PTRS_PER_SECTOR) < PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+    {
+      root = &disk_inode->doubly_indirect;
+      levels = 2;
+    }
   else
-    return -1;
+    return false;
+
+  if (*root == 0)
+    {
+      if (!allocate || !allocate_zeroed (root))
+        return false;
+      cache_write (inode_sector, disk_inode, 0, DISK_SECTOR_SIZE);
+    }
+
+  /* Walk down the index sectors. */
+  sector = *root;
+  for (; levels > 0; levels--)
+    {
+      size_t ofs = levels == 2 ? idx / PTRS_PER_SECTOR : idx % PTRS_PER_SECTOR;
+      if (!index_lookup (sector, ofs, allocate, &sector))
+        return false;
+    }
+  *sectorp = sector;
+  return true;
+}
+
+/* Releases index sector BLOCK, which is LEVELS levels above the
+   data sectors, along with every sector it refers to. */
+static void
+release_index (disk_sector_t block, int levels)
+{
+  size_t i;
+
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    {
+      disk_sector_t sector;
+
+      cache_read (block, &sector, i * sizeof sector, sizeof sector);
+      if (sector == 0)
+        continue;
+      if (levels > 1)
+        release_index (sector, levels - 1);
+      else
+        free_map_release (sector, 1);
+    }
+  free_map_release (block, 1);
+}
+
+/* Releases all of the data and index sectors of DISK_INODE. */
+static void
+release_sectors (const struct inode_disk *disk_inode)
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (disk_inode->direct[i] != 0)
+      free_map_release (disk_inode->direct[i], 1);
+  if (disk_inode->indirect != 0)
+    release_index (disk_inode->indirect, 1);
+  if (disk_inode->doubly_indirect != 0)
+    release_index (disk_inode->doubly_indirect, 2);
+}
+
+/* Open inodes, so that opening a single inode twice returns the
+   same `struct inode'.  The table is split into OPEN_STRIPE_CNT
+   stripes by sector number, each a hash table with its own lock,
+   so that opening and closing different files rarely contend. */
+#define OPEN_STRIPE_CNT 16
+
+struct open_stripe
+  {
+    struct lock lock;                   /* Protects INODES. */
+    struct hash inodes;                 /* Open inodes, by sector. */
+  };
+
+static struct open_stripe open_inodes[OPEN_STRIPE_CNT];
+
+/* Returns the stripe of the open inode table for SECTOR. */
+static struct open_stripe *
+stripe_of (disk_sector_t sector)
+{
+  return &open_inodes[sector % OPEN_STRIPE_CNT];
+}
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode_key, elem)->sector);
+}
+
+/* Returns true if inode A's sector precedes inode B's. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode_key, elem)->sector
+          < hash_entry (b, struct inode_key, elem)->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
-static struct lock open_inodes_lock;
+/* Cache of `struct inode's.  Inodes are freed to it with their
+   locks released, so the locks are initialized only once, by
+   inode_ctor(). */
+static struct kmem_cache *inode_cache;
+
+/* Constructs inode OBJ for inode_cache. */
+static void
+inode_ctor (void *obj)
+{
+  struct inode *inode = obj;
+  lock_init (&inode->metadata_lock);
+  rwlock_init (&inode->rw);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
-  list_init (&open_inodes);
-  lock_init(&open_inodes_lock);
+  size_t i;
+
+  for (i = 0; i < OPEN_STRIPE_CNT; i++)
+    {
+      lock_init (&open_inodes[i].lock);
+      if (!hash_init (&open_inodes[i].inodes, inode_hash, inode_less, NULL))
+        PANIC ("open inode table creation failed");
+    }
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), inode_ctor);
+  if (inode_cache == NULL)
+    PANIC ("inode cache creation failed");
+}
+
+/* Frees the open inode table.  Called when the file system is
+   shut down, after every inode has been closed. */
+void
+inode_done (void)
+{
+  size_t i;
+
+  for (i = 0; i < OPEN_STRIPE_CNT; i++)
+    hash_destroy (&open_inodes[i].inodes, NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -94,21 +288,23 @@ inode_create (disk_sector_t sector, off_t length)
   if (disk_inode != NULL)
     {
       size_t sectors = bytes_to_sectors (length);
+      disk_sector_t data_sector;
+      size_t i;
+
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
-        {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0)
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-
-              for (i = 0; i < sectors; i++)
-                disk_write (filesys_disk, disk_inode->start + i, zeros);
-            }
-          success = true;
-        }
+      cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+
+      /* Sectors are allocated one at a time, so they need not
+         be contiguous. */
+      success = true;
+      for (i = 0; i < sectors; i++)
+        if (!lookup_sector (sector, disk_inode, i, true, &data_sector))
+          {
+            release_sectors (disk_inode);
+            success = false;
+            break;
+          }
       free (disk_inode);
     }
   return success;
@@ -120,48 +316,40 @@ inode_create (disk_sector_t sector, off_t length)
 struct inode *
 inode_open (disk_sector_t sector)
 {
-  struct list_elem *e;
+  struct open_stripe *stripe = stripe_of (sector);
+  struct inode_key key;
   struct inode *inode;
-
+  struct hash_elem *e;
 
   /* Check whether this inode is already open. */
-  lock_acquire(&open_inodes_lock);
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e))
+  lock_acquire(&stripe->lock);
+  key.sector = sector;
+  e = hash_find (&stripe->inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector)
-        {
-          inode_reopen (inode);
-          lock_release(&open_inodes_lock);
-          return inode;
-        }
+      inode = hash_entry (e, struct inode, key.elem);
+      inode_reopen (inode);
+      lock_release(&stripe->lock);
+      return inode;
     }
-  
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
-  
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
   {
-    lock_release(&open_inodes_lock);
+    lock_release(&stripe->lock);
     return NULL;
   }
 
-  list_push_front (&open_inodes, &inode->elem);
-
   /* Initialize. */
-  inode->sector = sector;
+  inode->key.sector = sector;
   inode->open_cnt = 1;
   inode->removed = false;
+  inode->deny_write_cnt = 0;
+  hash_insert (&stripe->inodes, &inode->key.elem);
 
-  inode->writing = false;
-  inode->read_cnt = 0;
-  lock_init(&inode->metadata_lock);
-  cond_init(&inode->write_cond);
-
-  disk_read (filesys_disk, inode->sector, &inode->data);
-  lock_release(&open_inodes_lock);
+  cache_read (inode->key.sector, &inode->data, 0, DISK_SECTOR_SIZE);
+  lock_release(&stripe->lock);
   return inode;
 }
 
@@ -182,7 +370,7 @@ inode_reopen (struct inode *inode)
 disk_sector_t
 inode_get_inumber (const struct inode *inode)
 {
-  return inode->sector;
+  return inode->key.sector;
 }
 
 /* Closes INODE and writes it to disk.
@@ -191,33 +379,35 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode)
 {
+  struct open_stripe *stripe;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
-  lock_acquire(&open_inodes_lock);
+  stripe = stripe_of (inode->key.sector);
+  lock_acquire(&stripe->lock);
 
   /* Release resources if this was the last opener. */
   lock_acquire(&inode->metadata_lock);
   if (--inode->open_cnt == 0)
     {
       lock_release(&inode->metadata_lock);
-      /* Remove from inode list. */
-      list_remove (&inode->elem);
-      lock_release(&open_inodes_lock);
+      /* Remove from open inode table. */
+      hash_delete (&stripe->inodes, &inode->key.elem);
+      lock_release(&stripe->lock);
 
       /* Deallocate blocks if the file is marked as removed. */
       if (inode->removed)
         {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length));
+          free_map_release (inode->key.sector, 1);
+          release_sectors (&inode->data);
         }
 
-      free (inode);
+      kmem_cache_free (inode_cache, inode);
       return;
     }
   lock_release(&inode->metadata_lock);
-  lock_release(&open_inodes_lock);
+  lock_release(&stripe->lock);
   
 }
 
@@ -234,22 +424,30 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset)
+{
+  return inode_read_ahead_at (inode, buffer, size, offset, false);
+}
+
+/* Like inode_read_at(), but if SEQUENTIAL is true, which the
+   caller sets when this read continues where its previous read
+   of INODE ended, also has the sector after the last one read
+   brought into the cache in the background. */
+off_t
+inode_read_ahead_at (struct inode *inode, void *buffer_, off_t size,
+                     off_t offset, bool sequential)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
-  lock_acquire(&inode->metadata_lock);
-  while (inode->writing) {
-    cond_wait(&inode->write_cond, &inode->metadata_lock);
-  }
-  ++inode->read_cnt;
-  lock_release(&inode->metadata_lock);
+  rwlock_acquire_read (&inode->rw);
 
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
+      disk_sector_t sector_idx;
+      bool present = lookup_sector (inode->key.sector, &inode->data,
+                                    offset / DISK_SECTOR_SIZE, false,
+                                    &sector_idx);
       int sector_ofs = offset % DISK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -262,23 +460,33 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
+      if (!present)
+        {
+          /* A hole left by a write past end of file. */
+          memset (buffer + bytes_read, 0, chunk_size);
+        }
+      else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read);
+          /* Read the following full sectors too, as long as they
+             are adjacent on disk, so that the whole span can be
+             transferred by a single disk command. */
+          size_t cnt = 1;
+          disk_sector_t next;
+          while ((off_t) ((cnt + 1) * DISK_SECTOR_SIZE) <= size
+                 && offset + (off_t) ((cnt + 1) * DISK_SECTOR_SIZE)
+                    <= inode_length (inode)
+                 && lookup_sector (inode->key.sector, &inode->data,
+                                   offset / DISK_SECTOR_SIZE + cnt, false,
+                                   &next)
+                 && next == sector_idx + cnt)
+            cnt++;
+          cache_read_multi (sector_idx, cnt, buffer + bytes_read);
+          chunk_size = cnt * DISK_SECTOR_SIZE;
         }
       else
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          /* Copy the chunk out of the buffer cache. */
+          cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
         }
 
       /* Advance. */
@@ -287,21 +495,28 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
 
-  free (bounce);
-  lock_acquire(&inode->metadata_lock);
-  --inode->read_cnt;
-  if (inode->read_cnt == 0) {
-    cond_broadcast(&inode->write_cond, &inode->metadata_lock);
-  }
-  lock_release(&inode->metadata_lock);
+  /* A sequential reader is likely to read the next sector soon.
+     Random reads would only waste disk time and cache space on
+     read-ahead. */
+  offset = ROUND_UP (offset, DISK_SECTOR_SIZE);
+  if (sequential && bytes_read > 0 && offset < inode_length (inode))
+    {
+      disk_sector_t next;
+      if (lookup_sector (inode->key.sector, &inode->data,
+                         offset / DISK_SECTOR_SIZE, false, &next))
+        cache_readahead (next);
+    }
+
+  rwlock_release_read (&inode->rw);
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or the file reaches its
+   maximum size.
+   A write past end of file extends the inode.  Sectors skipped
+   over by the write are left unallocated and read as zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset)
@@ -310,75 +525,76 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
-  lock_acquire(&inode->metadata_lock);
-  while (inode->writing || inode->read_cnt) {
-    cond_wait(&inode->write_cond, &inode->metadata_lock);
-  }
-  inode->writing = true;
-  lock_release(&inode->metadata_lock);
+  rwlock_acquire_write (&inode->rw);
+
+  if (inode->deny_write_cnt > 0)
+    {
+      rwlock_release_write (&inode->rw);
+      return 0;
+    }
 
   while (size > 0)
     {
-      /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Sector to write, starting byte offset within sector.
+         The sector is allocated if the file does not have it
+         yet. */
+      disk_sector_t sector_idx;
       int sector_ofs = offset % DISK_SECTOR_SIZE;
-
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if (!lookup_sector (inode->key.sector, &inode->data,
+                          offset / DISK_SECTOR_SIZE, true, &sector_idx))
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          lock_acquire(&inode->metadata_lock);
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written);
-          lock_release(&inode->metadata_lock);
+      /* Number of bytes to actually write into this sector. */
+      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-        }
-      else
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left)
-            disk_read (filesys_disk, sector_idx, bounce);
-          else
-            memset (bounce, 0, DISK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce);
-        }
+      /* Copy the chunk into the buffer cache.  A partially
+         written sector is read in first by the cache. */
+      cache_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
+
+  /* Extend the file if the write went past its end. */
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      cache_write (inode->key.sector, &inode->data, 0, DISK_SECTOR_SIZE);
+    }
     
-  lock_acquire(&inode->metadata_lock);
-  inode->writing = false;
-  cond_broadcast(&inode->write_cond, &inode->metadata_lock);
-  lock_release(&inode->metadata_lock);
-  free (bounce);
+  rwlock_release_write (&inode->rw);
   
 
   return bytes_written;
 }
 
+/* Disables writes to INODE.
+   May be called at most once per inode opener. */
+void
+inode_deny_write (struct inode *inode)
+{
+  rwlock_acquire_write (&inode->rw);
+  inode->deny_write_cnt++;
+  ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rw);
+}
+
+/* Re-enables writes to INODE.
+   Must be called once by each inode opener who has called
+   inode_deny_write() on the inode, before closing the inode. */
+void
+inode_allow_write (struct inode *inode)
+{
+  rwlock_acquire_write (&inode->rw);
+  ASSERT (inode->deny_write_cnt > 0);
+  ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rw);
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -9,6 +9,7 @@ struct bitmap;
 
 
 void inode_init (void);
+void inode_done (void);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
@@ -16,7 +17,11 @@ disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_ahead_at (struct inode *, void *, off_t size, off_t offset,
+                           bool sequential);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+void inode_deny_write (struct inode *);
+void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 
 #endif /* filesys/inode.h */
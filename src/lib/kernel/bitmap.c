@@ -359,6 +359,23 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the SIZE bytes of B that start at byte offset OFS to the
+   same offset in FILE, which must already hold the rest of B.
+   Bytes past the end of B are ignored.  Returns true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t ofs, size_t size)
+{
+  size_t file_size = byte_cnt (b->bit_cnt);
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return (file_write_at (file, (const char *) b->bits + ofs, size, ofs)
+          == (off_t) size);
+}
 #endif /* FILESYS */
 
 /* Debugging. */
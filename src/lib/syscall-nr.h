@@ -32,6 +32,7 @@ enum
 
     SYS_PLIST,
     SYS_SLEEP,
+    SYS_TICKETS,                /* Set this process's CPU tickets. */
 
     SYS_NUMBER_OF_CALLS
   };
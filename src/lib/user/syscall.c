@@ -193,4 +193,10 @@ void
 sleep(int millis)
 {
   syscall1(SYS_SLEEP, millis);
-}
\ No newline at end of file
+}
+
+int
+tickets(int count)
+{
+  return syscall1(SYS_TICKETS, count);
+}
@@ -47,5 +47,6 @@ int inumber (int fd);
 
 void plist(void);
 void sleep(int millis);
+int tickets(int count);
 
 #endif /* lib/user/syscall.h */
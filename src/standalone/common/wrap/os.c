@@ -300,3 +300,74 @@ double timer_elapsed(int64_t since) {
 }
 
 #endif
+
+/**
+ * Readers-writer lock. Same algorithm as in threads/synch.c, built on the
+ * primitives above so that it works on both POSIX and Win32.
+ *
+ * A reader that arrives while a writer holds or waits for the lock waits,
+ * and when a writer releases the lock all readers that were waiting are let
+ * in before the next writer. Neither side can starve the other.
+ */
+
+void rwlock_init(struct rwlock *rw) {
+    lock_init(&rw->lock);
+    cond_init(&rw->readers);
+    cond_init(&rw->writers);
+    rw->active_readers = 0;
+    rw->waiting_readers = 0;
+    rw->waiting_writers = 0;
+    rw->read_phase = 0;
+    rw->writer = false;
+}
+
+void rwlock_destroy(struct rwlock *rw) {
+    cond_destroy(&rw->writers);
+    cond_destroy(&rw->readers);
+    lock_destroy(&rw->lock);
+}
+
+void rwlock_acquire_read(struct rwlock *rw) {
+    lock_acquire(&rw->lock);
+    if (rw->writer || rw->waiting_writers > 0) {
+        // rwlock_release_write counts us as an active reader when it lets us in.
+        unsigned phase = rw->read_phase;
+        rw->waiting_readers++;
+        while (rw->read_phase == phase)
+            cond_wait(&rw->readers, &rw->lock);
+    } else {
+        rw->active_readers++;
+    }
+    lock_release(&rw->lock);
+}
+
+void rwlock_release_read(struct rwlock *rw) {
+    lock_acquire(&rw->lock);
+    if (--rw->active_readers == 0 && rw->waiting_writers > 0)
+        cond_signal(&rw->writers, &rw->lock);
+    lock_release(&rw->lock);
+}
+
+void rwlock_acquire_write(struct rwlock *rw) {
+    lock_acquire(&rw->lock);
+    rw->waiting_writers++;
+    while (rw->writer || rw->active_readers > 0)
+        cond_wait(&rw->writers, &rw->lock);
+    rw->waiting_writers--;
+    rw->writer = true;
+    lock_release(&rw->lock);
+}
+
+void rwlock_release_write(struct rwlock *rw) {
+    lock_acquire(&rw->lock);
+    rw->writer = false;
+    if (rw->waiting_readers > 0) {
+        rw->active_readers += rw->waiting_readers;
+        rw->waiting_readers = 0;
+        rw->read_phase++;
+        cond_broadcast(&rw->readers, &rw->lock);
+    } else if (rw->waiting_writers > 0) {
+        cond_signal(&rw->writers, &rw->lock);
+    }
+    lock_release(&rw->lock);
+}
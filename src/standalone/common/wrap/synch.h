@@ -33,3 +33,22 @@ void cond_destroy(struct condition *cond);
 void cond_wait(struct condition *cond, struct lock *lock);
 void cond_signal(struct condition *cond, struct lock *lock);
 void cond_broadcast(struct condition *cond, struct lock *lock);
+
+struct rwlock {
+    // Privat data. Använd funktionerna nedan för att manipulera låset.
+    struct lock lock;
+    struct condition readers;
+    struct condition writers;
+    unsigned active_readers;
+    unsigned waiting_readers;
+    unsigned waiting_writers;
+    unsigned read_phase;
+    bool writer;
+};
+
+void rwlock_init(struct rwlock *rw);
+void rwlock_destroy(struct rwlock *rw);
+void rwlock_acquire_read(struct rwlock *rw);
+void rwlock_release_read(struct rwlock *rw);
+void rwlock_acquire_write(struct rwlock *rw);
+void rwlock_release_write(struct rwlock *rw);
@@ -0,0 +1,43 @@
+/* Child process for syn-read-ahead test.
+   Reads the contents of a test file front to back, a sector-sized
+   chunk at a time, and checks them. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-read-ahead.h"
+
+const char *test_name = "child-read-ahead";
+
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[])
+{
+  char chunk[CHUNK_SIZE];
+  int child_idx;
+  int fd;
+  size_t i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+             "read \"%s\"", file_name);
+      compare_bytes (chunk, buf + i * CHUNK_SIZE, CHUNK_SIZE,
+                     i * CHUNK_SIZE, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
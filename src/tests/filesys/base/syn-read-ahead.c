@@ -0,0 +1,33 @@
+/* Spawns 2 child processes that read the same file front to back
+   at the same time, like two log scanners, and make sure that the
+   contents are what they should be.  Each reader's reads are
+   sequential, so each of them should cause read-ahead even though
+   their reads of the shared inode are interleaved. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-read-ahead.h"
+
+static char buf[BUF_SIZE];
+
+#define CHILD_CNT 2
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) > 0, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  exec_children ("child-read-ahead", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-read-ahead) begin
+(syn-read-ahead) create "log"
+(syn-read-ahead) open "log"
+(syn-read-ahead) write "log"
+(syn-read-ahead) close "log"
+(syn-read-ahead) exec child 1 of 2: "child-read-ahead 0"
+(syn-read-ahead) exec child 2 of 2: "child-read-ahead 1"
+(syn-read-ahead) wait for child 1 of 2 returned 0 (expected 0)
+(syn-read-ahead) wait for child 2 of 2 returned 1 (expected 1)
+(syn-read-ahead) end
+EOF
+
+# Each child makes 32 sequential one-sector reads of the file, and
+# every one but the last, which ends at end of file, should ask for
+# the next sector to be read ahead.
+my (@output) = read_text_file ("$test.output");
+my ($requests) = map (/^Cache: (\d+) read-ahead requests/, @output);
+fail "No read-ahead statistics in output.\n" if !defined $requests;
+fail "Only $requests read-ahead requests, expected at least 62.\n"
+  if $requests < 62;
+pass;
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_SYN_READ_AHEAD_H
+#define TESTS_FILESYS_BASE_SYN_READ_AHEAD_H
+
+#define CHUNK_SIZE 512
+#define CHUNK_CNT 32
+#define BUF_SIZE (CHUNK_SIZE * CHUNK_CNT)
+static const char file_name[] = "log";
+
+#endif /* tests/filesys/base/syn-read-ahead.h */
@@ -0,0 +1,41 @@
+/* Multiplies two 128x128 matrices, like examples/matmult.c, and
+   checks the result.  The three matrices take 576 kB, which is
+   more than the user pool holds under the -ul limit this test
+   runs with, so pages must be evicted to swap and read back. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DIM 128
+
+static int a[DIM][DIM];
+static int b[DIM][DIM];
+static int c[DIM][DIM];
+
+void
+test_main (void)
+{
+  int i, j, k;
+
+  msg ("initialize");
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      {
+        a[i][j] = i;
+        b[i][j] = j;
+        c[i][j] = 0;
+      }
+
+  msg ("multiply");
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      for (k = 0; k < DIM; k++)
+        c[i][j] += a[i][k] * b[k][j];
+
+  /* Every entry is the sum over K of I * J. */
+  msg ("check");
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      if (c[i][j] != i * j * DIM)
+        fail ("c[%d][%d] is %d, expected %d", i, j, c[i][j], i * j * DIM);
+}
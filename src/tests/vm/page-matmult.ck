@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-matmult) begin
+(page-matmult) initialize
+(page-matmult) multiply
+(page-matmult) check
+(page-matmult) end
+EOF
+pass;
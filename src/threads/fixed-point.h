@@ -0,0 +1,50 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, as used by the
+   multi-level feedback queue scheduler.  The low FP_SHIFT bits of
+   a fixed_point hold the fraction.  Products and quotients are
+   computed in 64 bits so that they do not overflow in between. */
+typedef int fixed_point;
+
+#define FP_SHIFT 14
+#define FP_ONE (1 << FP_SHIFT)
+
+/* Returns integer N as a fixed-point number. */
+static inline fixed_point
+fp_from_int (int n)
+{
+  return n * FP_ONE;
+}
+
+/* Returns X truncated toward zero. */
+static inline int
+fp_trunc (fixed_point x)
+{
+  return x / FP_ONE;
+}
+
+/* Returns X rounded to the nearest integer. */
+static inline int
+fp_round (fixed_point x)
+{
+  return x >= 0 ? (x + FP_ONE / 2) / FP_ONE : (x - FP_ONE / 2) / FP_ONE;
+}
+
+/* Returns X * Y. */
+static inline fixed_point
+fp_mul (fixed_point x, fixed_point y)
+{
+  return (int64_t) x * y / FP_ONE;
+}
+
+/* Returns X / Y. */
+static inline fixed_point
+fp_div (fixed_point x, fixed_point y)
+{
+  return (int64_t) x * FP_ONE / y;
+}
+
+#endif /* threads/fixed-point.h */
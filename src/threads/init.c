@@ -19,6 +19,7 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -32,9 +33,15 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Amount of physical memory, in 4 kB pages. */
 size_t ram_pages;
@@ -144,6 +151,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
 
   /* Run actions specified on kernel command line. */
@@ -282,6 +295,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-stride"))
+        thread_stride = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -289,6 +306,18 @@ parse_options (char **argv)
         free_page_limit = atoi (value);
       else if (!strcmp (name, "-tcl")) // klaar@ida
         thread_create_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        {
+          /* Page 0 is never mapped, so the stack can have every
+             other user page. */
+          int pages = atoi (value);
+          if (pages < 1 || pages > (int) (pg_no (PHYS_BASE) - 1))
+            PANIC ("-sl must be between 1 and %u pages",
+                   (unsigned) (pg_no (PHYS_BASE) - 1));
+          stack_page_limit = pages;
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -394,10 +423,15 @@ usage (void)
           "  -F=COUNT           Interrupts per second [20-60000].\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -stride            Use stride (proportional-share) scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
           "  -fl=COUNT          Limit free memory to COUNT pages.\n"
           "  -tcl=N             Fail at call N to thread_create.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
 #endif
           );
 
@@ -478,8 +512,14 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+#ifdef VM
+  frame_print_stats ();
+#endif
+  kmem_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
+  cache_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
@@ -4,7 +4,25 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of block sizes with per-thread magazines: the smallest
+   ones, 16 to 128 bytes, which are allocated most often.  The
+   magazines are part of `struct thread', so they are kept small
+   to leave room for the kernel stack. */
+#define MAGAZINE_CLASS_CNT 4
+
+/* Number of free blocks a magazine holds. */
+#define MAGAZINE_ROUNDS 4
+
+/* Free blocks of one size cached by a thread, which malloc() and
+   free() use without locking.  Owned by malloc.c. */
+struct magazine
+  {
+    unsigned cnt;                       /* Number of blocks held. */
+    void *rounds[MAGAZINE_ROUNDS];      /* Blocks, most recent last. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
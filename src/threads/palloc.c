@@ -2,14 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,14 +25,47 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  A block of order K is 2**K pages whose index within
+   the pool is a multiple of 2**K, and its "buddy" is the other
+   half of the order K+1 block that contains it.  Each order has a
+   list of free blocks, linked through the blocks' first pages.
+   A request for N pages takes a free block of the smallest order
+   K with 2**K >= N, splitting a larger block if necessary, and
+   gives back the pages past the first N.  Freed blocks are merged
+   with their buddies for as long as those are free too, so both
+   allocation and freeing take time logarithmic in the pool size
+   instead of a scan of the pool.
+
+   The free lists are updated with interrupts disabled rather than
+   under a lock, because schedule_tail() frees the page of a dying
+   thread in the middle of a thread switch, where it must not
+   block.  That keeps each critical section short and bounded. */
+
+/* Number of block orders.  The largest block is 2**(ORDER_CNT - 1)
+   pages, which is larger than any pool. */
+#define ORDER_CNT 20
+
+/* ORDERS[] value for a page that does not start a free block. */
+#define NOT_FREE 0xff
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *orders;                    /* Order of free block at each
+                                           page, or NOT_FREE. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks by order. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    const char *name;                   /* Name, for statistics. */
+
+    /* Statistics. */
+    size_t free_cnt;                    /* Free pages. */
+    unsigned frag_failures;             /* Failed requests for fewer
+                                           pages than were free. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -44,6 +78,10 @@ size_t free_page_limit = SIZE_MAX; // klaar@ida
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t get_block (struct pool *, size_t page_cnt);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void push_block (struct pool *, size_t page_idx, int order);
+static void remove_block (struct pool *, size_t page_idx);
 
 /* Initializes the page allocator. */
 void
@@ -85,15 +123,21 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  page_idx = get_block (pool, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    {
+      ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+    }
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -132,6 +176,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -151,8 +196,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -162,15 +210,58 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints fragmentation statistics for POOL. */
+static void
+print_pool_stats (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t block_cnt = 0;
+  size_t largest = 0;
+  size_t free_cnt;
+  unsigned frag_failures;
+  int order;
+
+  old_level = intr_disable ();
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      size_t cnt = list_size (&pool->free_lists[order]);
+      block_cnt += cnt;
+      if (cnt > 0)
+        largest = (size_t) 1 << order;
+    }
+  free_cnt = pool->free_cnt;
+  frag_failures = pool->frag_failures;
+  intr_set_level (old_level);
+
+  printf ("Palloc %s: %zu of %zu pages free in %zu blocks, "
+          "largest %zu pages (%zu%% fragmented), "
+          "%u failures with enough free pages\n",
+          pool->name, free_cnt, pool->page_cnt, block_cnt, largest,
+          free_cnt > 0 ? 100 - largest * 100 / free_cnt : 0,
+          frag_failures);
+}
+
+/* Prints page allocator statistics.  A pool is fragmented to the
+   extent that its free pages are not in its largest free block. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and block orders at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -178,9 +269,19 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, NOT_FREE, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->name = name;
+  p->free_cnt = 0;
+  p->frag_failures = 0;
+
+  /* Make all the pages free. */
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -190,7 +291,105 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Takes PAGE_CNT free pages from POOL and returns the index of
+   the first, or BITMAP_ERROR if no free block is large enough.
+   Interrupts must be off. */
+static size_t
+get_block (struct pool *pool, size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t page_idx;
+  int order = 0;
+  int k;
+
+  while (((size_t) 1 << order) < page_cnt)
+    if (++order >= ORDER_CNT)
+      return BITMAP_ERROR;
+
+  /* Find the smallest free block that is large enough. */
+  for (k = order; k < ORDER_CNT; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k >= ORDER_CNT)
+    {
+      if (page_cnt <= pool->free_cnt)
+        pool->frag_failures++;
+      return BITMAP_ERROR;
+    }
+
+  e = list_front (&pool->free_lists[k]);
+  page_idx = pg_no (e) - pg_no (pool->base);
+  remove_block (pool, page_idx);
+
+  /* Split it down to ORDER, freeing the upper halves. */
+  while (k > order)
+    {
+      k--;
+      push_block (pool, page_idx + ((size_t) 1 << k), k);
+    }
+
+  /* Give back the pages that were not requested. */
+  pool->free_cnt -= (size_t) 1 << order;
+  free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/* Adds the PAGE_CNT pages starting at PAGE_IDX in POOL to its free
+   blocks, merging them with free buddies.  Interrupts must be
+   off, unless POOL is being initialized. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      /* The largest block that starts at PAGE_IDX and fits. */
+      int order = 0;
+      size_t next;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 1 << (order + 1)) == 0
+             && ((size_t) 1 << (order + 1)) <= page_cnt)
+        order++;
+      next = page_idx + ((size_t) 1 << order);
+      page_cnt -= (size_t) 1 << order;
+      pool->free_cnt += (size_t) 1 << order;
+
+      /* Merge with the buddy while it is a free block of the same
+         order. */
+      for (; order + 1 < ORDER_CNT; order++)
+        {
+          size_t buddy = page_idx ^ ((size_t) 1 << order);
+          if (buddy >= pool->page_cnt || pool->orders[buddy] != order)
+            break;
+          remove_block (pool, buddy);
+          page_idx &= ~((size_t) 1 << order);
+        }
+      push_block (pool, page_idx, order);
+      page_idx = next;
+    }
+}
+
+/* Adds the free block of ORDER at PAGE_IDX to POOL's free
+   lists. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  struct list_elem *e = (struct list_elem *) (pool->base
+                                              + PGSIZE * page_idx);
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free_lists[order], e);
+}
+
+/* Removes the free block at PAGE_IDX from POOL's free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx)
+{
+  ASSERT (pool->orders[page_idx] != NOT_FREE);
+  pool->orders[page_idx] = NOT_FREE;
+  list_remove ((struct list_elem *) (pool->base + PGSIZE * page_idx));
+}
@@ -0,0 +1,335 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   malloc() rounds every request up to a power of 2, which wastes
+   up to half of each block for objects whose size is just past a
+   power of 2.  An object cache instead hands out objects of one
+   exact size, carved from "slabs": pages obtained from the page
+   allocator that start with a slab header followed by as many
+   object slots as fit.
+
+   Each slab keeps a list of its free slots, linked through a
+   pointer stored in the slot.  A cache with a constructor runs it
+   once on every slot when the slab is created, and callers
+   return objects in their constructed state, so the link is
+   stored after the object to leave the object itself intact.
+
+   Slabs with free slots are on the cache's partial list and full
+   slabs on its full list.  When a slab's last object is freed,
+   the slab is returned to the page allocator, except that one
+   empty slab is kept to absorb alloc/free cycles. */
+
+/* Maximum number of caches. */
+#define CACHE_MAX 16
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x5ab1e5c7
+
+/* Object cache. */
+struct kmem_cache
+  {
+    char name[16];              /* Name, for statistics. */
+    size_t obj_size;            /* Object size requested. */
+    size_t slot_size;           /* Bytes per object in a slab. */
+    size_t link_ofs;            /* Offset of free list link in slot. */
+    size_t objs_per_slab;       /* Number of slots in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct list partial;        /* Slabs with at least one free slot. */
+    struct list full;           /* Slabs without free slots. */
+    size_t empty_cnt;           /* Slabs in PARTIAL with no objects. */
+    struct lock lock;           /* Lock. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs allocated. */
+    size_t in_use;              /* Objects allocated. */
+    size_t peak;                /* Highest IN_USE seen. */
+    unsigned long long alloc_cnt; /* Calls to kmem_cache_alloc(). */
+    unsigned long long free_cnt;  /* Calls to kmem_cache_free(). */
+  };
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's slab lists. */
+    size_t in_use;              /* Objects allocated from this slab. */
+    void *free;                 /* First free slot, or null. */
+  };
+
+static struct kmem_cache caches[CACHE_MAX];
+static size_t cache_cnt;
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void **slot_link (struct kmem_cache *, void *);
+
+/* Creates and returns a cache of SIZE-byte objects called NAME.
+   If CTOR is nonnull, it is run on each object when the object's
+   slab is created.  Returns a null pointer if too many caches
+   exist.  Caches are never destroyed. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+
+  ASSERT (size > 0);
+
+  if (cache_cnt >= CACHE_MAX)
+    return NULL;
+  c = &caches[cache_cnt++];
+
+  strlcpy (c->name, name, sizeof c->name);
+  c->obj_size = size;
+  c->ctor = ctor;
+  if (ctor != NULL)
+    {
+      /* Keep the link out of the constructed object. */
+      c->link_ofs = ROUND_UP (size, sizeof (void *));
+      c->slot_size = c->link_ofs + sizeof (void *);
+    }
+  else
+    {
+      /* A free object's contents don't matter, so the link can
+         overlay it. */
+      c->link_ofs = 0;
+      c->slot_size = ROUND_UP (size, sizeof (void *));
+    }
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->slot_size;
+  ASSERT (c->objs_per_slab > 0);
+
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->empty_cnt = 0;
+  lock_init (&c->lock);
+
+  c->slab_cnt = c->in_use = c->peak = 0;
+  c->alloc_cnt = c->free_cnt = 0;
+  return c;
+}
+
+/* Obtains and returns an object from cache C.  The object is in
+   its constructed state if C has a constructor.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* If no slab has a free slot, create a new slab. */
+  if (list_empty (&c->partial))
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+      c->empty_cnt++;
+    }
+
+  /* Take the first free slot of the first slab with one.  Empty
+     slabs go to the back of the list, so partly used slabs fill
+     up first. */
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  if (s->in_use++ == 0)
+    c->empty_cnt--;
+  obj = s->free;
+  s->free = *slot_link (c, obj);
+  if (s->free == NULL)
+    {
+      list_remove (&s->elem);
+      list_push_back (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak)
+    c->peak = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   kmem_cache_alloc(), to C.  Does nothing if OBJ is null. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  /* A full slab gets a free slot again. */
+  if (s->free == NULL)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  *slot_link (c, obj) = s->free;
+  s->free = obj;
+  c->free_cnt++;
+  c->in_use--;
+
+  /* If the slab is now unused, keep it as the spare empty slab or
+     free it. */
+  if (--s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt > 0)
+        {
+          s->magic = 0;
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+      else
+        {
+          list_push_back (&c->partial, &s->elem);
+          c->empty_cnt++;
+        }
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each object cache. */
+void
+kmem_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      printf ("Slab %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use (peak %zu), %llu allocs, %llu frees, "
+              "%zu bytes unused\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->in_use, c->peak, c->alloc_cnt, c->free_cnt,
+              c->slab_cnt * PGSIZE - c->in_use * c->obj_size);
+    }
+}
+
+#ifdef LEAKCHECK
+/* Returns the number of objects allocated from all caches and not
+   freed. */
+size_t
+kmem_leak_cnt (void)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      lock_acquire (&caches[i].lock);
+      cnt += caches[i].in_use;
+      lock_release (&caches[i].lock);
+    }
+  return cnt;
+}
+
+/* Prints each cache that has objects that were not freed, in the
+   format of malloc_check_leaks(), and returns the number of such
+   objects.  Objects in a cache all come from the same allocation
+   site, so the cache's name stands in for the location. */
+size_t
+kmem_report_leaks (void)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      size_t in_use;
+
+      lock_acquire (&c->lock);
+      in_use = c->in_use;
+      lock_release (&c->lock);
+      if (in_use > 0)
+        printf ("Memory leak detected:\n  %zu objects\n"
+                "  Allocated from slab cache: %s\n", in_use, c->name);
+      cnt += in_use;
+    }
+  return cnt;
+}
+#endif
+
+/* Allocates a new slab for cache C and constructs its objects.
+   Returns the slab, or a null pointer if memory is not
+   available. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Link the slots in address order. */
+  for (i = c->objs_per_slab; i-- > 0; )
+    {
+      void *obj = (uint8_t *) (s + 1) + i * c->slot_size;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *slot_link (c, obj) = s->free;
+      s->free = obj;
+    }
+
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object of cache C, is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((pg_ofs (obj) - sizeof *s) % c->slot_size == 0);
+
+  return s;
+}
+
+/* Returns the free list link of OBJ, an object of cache C. */
+static void **
+slot_link (struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
@@ -0,0 +1,26 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* An object cache, which hands out objects of a single size. */
+struct kmem_cache;
+
+/* Constructor, run once on each object when the slab that holds
+   it is created.  Objects must be in their constructed state
+   again when they are passed to kmem_cache_free(). */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#ifdef LEAKCHECK
+/* Leak checking: objects still allocated at shutdown. */
+size_t kmem_leak_cnt (void);
+size_t kmem_report_leaks (void);
+#endif
+
+#endif /* threads/slab.h */
@@ -102,7 +102,8 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.
 
    This function may be called from an interrupt handler. */
 void
@@ -114,10 +115,19 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters))
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      /* Wake the highest-priority waiter. */
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
   intr_set_level (old_level);
+
+  /* thread_unblock() did not preempt us with interrupts off. */
+  if (old_level == INTR_ON)
+    thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -185,6 +195,10 @@ lock_init (struct lock *lock)
    necessary.  The lock must not already be held by the current
    thread.
 
+   While waiting, the current thread donates its priority to the
+   thread holding LOCK, so that a low-priority holder cannot keep
+   it waiting behind medium-priority threads.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +206,42 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL && !thread_mlfqs)
+    {
+      /* Donate our priority to the holder, and on down the
+         chain of threads that each wait for a lock held by the
+         next.  A donation stops where it would not raise a
+         priority.  Depth is bounded so that a deadlock cannot
+         loop forever. */
+      struct lock *l;
+      int depth;
+
+      cur->waiting_lock = lock;
+      for (l = lock, depth = 0; l != NULL && l->holder != NULL && depth < 8;
+           l = l->holder->waiting_lock, depth++)
+        {
+          if (l->holder->priority >= cur->priority)
+            break;
+          thread_donate_priority (l->holder, cur->priority);
+        }
+    }
+  intr_set_level (old_level);
+
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+
+  old_level = intr_disable ();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,7 +260,12 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      enum intr_level old_level = intr_disable ();
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+      intr_set_level (old_level);
+    }
   return success;
 }
 
@@ -228,10 +277,19 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Give back the priority donated through LOCK.  sema_up()
+     yields if that leaves a waiter with a higher priority. */
+  old_level = intr_disable ();
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  if (!thread_mlfqs)
+    thread_update_priority (thread_current ());
+  intr_set_level (old_level);
   sema_up (&lock->semaphore);
 }
 
@@ -251,8 +309,19 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+/* Returns true if the thread waiting on semaphore_elem A has a
+   lower priority than the one waiting on B. */
+static bool
+waiter_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct semaphore_elem, elem)->thread->priority
+          < list_entry (b, struct semaphore_elem, elem)->thread->priority);
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,6 +364,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
 
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -302,7 +372,8 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest-priority one to wake up from
+   its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -317,8 +388,13 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters))
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      /* Signal the highest-priority waiter. */
+      struct list_elem *e = list_max (&cond->waiters,
+                                      waiter_priority_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +412,103 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a readers-writer lock.  Any number of
+   readers may hold RW at once, or a single writer.
+
+   RW is phase-fair: a reader that arrives while a writer holds
+   or waits for RW waits, so that a steady stream of readers
+   cannot starve writers, and when a writer releases RW every
+   reader that was waiting is let in before the next writer, so
+   that writers cannot starve readers either.  Readers and
+   writers wait on separate condition variables so that a
+   release only wakes the threads that can proceed. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->readers);
+  cond_init (&rw->writers);
+  rw->active_readers = 0;
+  rw->waiting_readers = 0;
+  rw->waiting_writers = 0;
+  rw->read_phase = 0;
+  rw->writer = false;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or
+   waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  if (rw->writer || rw->waiting_writers > 0)
+    {
+      /* rwlock_release_write() counts us as an active reader
+         when it lets us in. */
+      unsigned phase = rw->read_phase;
+      rw->waiting_readers++;
+      while (rw->read_phase == phase)
+        cond_wait (&rw->readers, &rw->lock);
+    }
+  else
+    rw->active_readers++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->active_readers > 0);
+  if (--rw->active_readers == 0 && rw->waiting_writers > 0)
+    cond_signal (&rw->writers, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until neither readers nor
+   another writer hold it. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  rw->waiting_writers++;
+  while (rw->writer || rw->active_readers > 0)
+    cond_wait (&rw->writers, &rw->lock);
+  rw->waiting_writers--;
+  rw->writer = true;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing.
+   Waiting readers are let in first, then a waiting writer. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer);
+  rw->writer = false;
+  if (rw->waiting_readers > 0)
+    {
+      rw->active_readers += rw->waiting_readers;
+      rw->waiting_readers = 0;
+      rw->read_phase++;
+      cond_broadcast (&rw->readers, &rw->lock);
+    }
+  else if (rw->waiting_writers > 0)
+    cond_signal (&rw->writers, &rw->lock);
+  lock_release (&rw->lock);
+}
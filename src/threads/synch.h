@@ -20,8 +20,9 @@ void sema_self_test (void);
 /* Lock. */
 struct lock
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
   };
 
 void lock_init (struct lock *);
@@ -41,6 +42,25 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readers;   /* Waiting readers. */
+    struct condition writers;   /* Waiting writers. */
+    unsigned active_readers;    /* Readers holding the lock. */
+    unsigned waiting_readers;   /* Readers waiting for the lock. */
+    unsigned waiting_writers;   /* Writers waiting for the lock. */
+    unsigned read_phase;        /* Bumped when waiting readers get in. */
+    bool writer;                /* Held by a writer? */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
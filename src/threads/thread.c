@@ -4,6 +4,7 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/fixed-point.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -11,6 +12,7 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -21,9 +23,18 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one FIFO queue per
+   priority.  Bit P of ready_mask is set if and only if
+   ready_queues[P] is nonempty, so that the highest priority with
+   a ready thread can be found without looking at the queues. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Number of threads in ready_queues. */
+
+/* List of all threads. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -47,6 +58,14 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Per-thread statistics of threads that have exited, so that
+   thread_print_stats() can report totals over all threads. */
+static struct thread_stats exited_stats;
+
+/* True while the running thread is being preempted rather than
+   giving up the CPU by itself. */
+static bool preempting;
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
@@ -56,17 +75,69 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler.
+
+   Priorities are computed from each thread's nice value and its
+   recent_cpu, an exponentially weighted average of the CPU time
+   it received, and are never donated.  recent_cpu and the system
+   load average load_avg are 17.14 fixed-point numbers.
+
+   Only the running thread's recent_cpu changes from one second
+   to the next, so every MLFQS_PRI_TICKS ticks only its priority
+   is recomputed.  load_avg and the recent_cpu and priority of all
+   other threads are recomputed once per second, with the number
+   of ready threads kept as a running count instead of counted. */
+#define MLFQS_PRI_TICKS 4       /* Ticks between priority updates. */
+#define NICE_MIN -20
+#define NICE_MAX 20
+static fixed_point load_avg;
+
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* Stride scheduler.
+
+   Each thread's pass value advances by STRIDE1 / tickets for
+   every tick it runs, and the ready thread with the lowest pass
+   runs next, so over time each thread gets CPU time in
+   proportion to its tickets.  Ready threads are kept in a binary
+   min-heap on pass.  A thread that becomes ready has its pass
+   raised to stride_pass, the pass of the last thread picked, so
+   that it cannot make up for the time it was blocked by
+   monopolizing the CPU. */
+#define STRIDE1 (1 << 20)
+#define STRIDE_HEAP_MAX (PGSIZE / sizeof (struct thread *))
+static struct thread **stride_heap;
+static size_t stride_heap_cnt;
+static int64_t stride_pass;
+
+static void add_stats (struct thread_stats *, const struct thread_stats *);
+static void stride_push (struct thread *);
+static struct thread *stride_pop (void);
+
+static void mlfqs_tick (struct thread *);
+static void mlfqs_second (void);
+static void mlfqs_update_priority (struct thread *);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static tid_t create_thread (const char *name, int priority,
+                            thread_func *, void *aux);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void yield (bool preempted);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static void set_priority (struct thread *, int priority);
+static int ready_max_priority (void);
 
 /* Initializes the threading system (not individual threads!) by
    transforming the code that's currently running into a thread.
@@ -85,12 +156,19 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+  int i;
+
   plist_init();
 
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_mask = 0;
+  ready_cnt = 0;
+  list_init (&all_list);
+  load_avg = 0;
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -106,6 +184,8 @@ thread_init (void)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -114,9 +194,30 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  t->waiting_lock = NULL;
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   t->magic = THREAD_MAGIC;
 
+  /* A new thread starts out with its creator's tickets. */
+  t->tickets = (t != running_thread () ? thread_current ()->tickets
+                : TICKETS_DEFAULT);
+
+  /* Under -mlfqs a new thread starts out with its creator's
+     nice and recent_cpu, and PRIORITY is ignored. */
+  if (thread_mlfqs && t != running_thread ())
+    {
+      t->nice = thread_current ()->nice;
+      t->recent_cpu = thread_current ()->recent_cpu;
+      mlfqs_update_priority (t);
+    }
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
+
   /* YES! You may want add stuff here. */
 }
 
@@ -125,8 +226,16 @@ init_thread (struct thread *t, const char *name, int priority)
 void
 thread_start (void)
 {
-  /* Create the idle thread. */
   struct semaphore idle_started;
+
+  if (thread_stride)
+    {
+      if (thread_mlfqs)
+        PANIC ("-mlfqs and -stride cannot be used together");
+      stride_heap = palloc_get_page (PAL_ASSERT);
+    }
+
+  /* Create the idle thread. */
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -145,6 +254,7 @@ thread_tick (void)
   struct thread *t = thread_current ();
 
   /* Update statistics. */
+  t->stats.run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -154,17 +264,99 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  else if (thread_stride && t != idle_thread)
+    t->pass += STRIDE1 / t->tickets;
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Counts CNT ticks that passed while the idle thread ran with
+   the periodic timer interrupt stopped. */
+void
+thread_idle_ticks (int64_t cnt)
+{
+  int64_t now = timer_ticks ();
+  int64_t seconds = now / TIMER_FREQ - (now - cnt) / TIMER_FREQ;
+
+  idle_ticks += cnt;
+
+  /* Catch up on the per-second updates that were skipped. */
+  if (thread_mlfqs)
+    while (seconds-- > 0)
+      mlfqs_second ();
+}
+
+/* Prints thread statistics: the global tick counts, then
+   context switch counts and the ready-queue wait histogram
+   summed over all threads, live and exited. */
 void
 thread_print_stats (void)
 {
+  struct thread_stats total = exited_stats;
+  struct list_elem *e;
+  enum intr_level old_level;
+  int i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    add_stats (&total, &list_entry (e, struct thread, allelem)->stats);
+  intr_set_level (old_level);
+
+  printf ("Thread: %u switches, %u voluntary, %u involuntary\n",
+          total.switches, total.voluntary, total.involuntary);
+  printf ("Thread: ready wait histogram (ticks):");
+  for (i = 0; i < WAIT_HIST_CNT; i++)
+    if (i < WAIT_HIST_CNT - 1)
+      printf (" <%d:%u", 1 << i, total.wait_hist[i]);
+    else
+      printf (" >=%d:%u", 1 << (i - 1), total.wait_hist[i]);
+  printf ("\n");
+}
+
+/* Copies the statistics of the thread with the given TID to
+   *STATS.  Returns false if there is no such thread. */
+bool
+thread_get_stats (tid_t tid, struct thread_stats *stats)
+{
+  struct list_elem *e;
+  enum intr_level old_level = intr_disable ();
+  bool found = false;
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t->tid == tid)
+        {
+          *stats = t->stats;
+          found = true;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+  return found;
+}
+
+/* Adds the counts in B to A. */
+static void
+add_stats (struct thread_stats *a, const struct thread_stats *b)
+{
+  int i;
+
+  a->run_ticks += b->run_ticks;
+  a->switches += b->switches;
+  a->voluntary += b->voluntary;
+  a->involuntary += b->involuntary;
+  for (i = 0; i < WAIT_HIST_CNT; i++)
+    a->wait_hist[i] += b->wait_hist[i];
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -179,12 +371,34 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, it runs before thread_create() returns. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux)
+{
+  /* Allows to simulate a failure in palloc_get_page below. */
+  if (DEBUG_thread_create_simulate_fail())
+    return TID_ERROR;
+
+  return create_thread (name, priority, function, aux);
+}
+
+/* Like thread_create(), but for kernel daemons, such as the file
+   system's background workers.  These are not counted by the
+   -tcl option, so that adding one does not change which call to
+   thread_create() a test makes fail. */
+tid_t
+thread_create_daemon (const char *name, int priority,
+                      thread_func *function, void *aux)
+{
+  return create_thread (name, priority, function, aux);
+}
+
+/* Does the work of thread_create(). */
+static tid_t
+create_thread (const char *name, int priority,
+               thread_func *function, void *aux)
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
@@ -196,10 +410,6 @@ thread_create (const char *name, int priority,
   
   ASSERT (function != NULL);
 
-  /* Allows to simulate a failure in palloc_get_page below. */
-  if (DEBUG_thread_create_simulate_fail())
-    return TID_ERROR;
-
   /* Allocate thread. */
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
@@ -254,10 +464,14 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   If T has a higher priority than the running thread, the
+   running thread is preempted, but only if that is safe: in an
+   interrupt handler the yield happens when the handler returns,
+   and if the caller had disabled interrupts itself, it may
+   expect that it can atomically unblock a thread and update
+   other data, so the running thread is not preempted at all.
+   Such callers should call thread_preempt() once they turn
+   interrupts back on. */
 void
 thread_unblock (struct thread *t)
 {
@@ -267,9 +481,52 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (t->pass < stride_pass)
+    t->pass = stride_pass;
+  t->stats.ready_since = timer_ticks ();
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
+
+  if (old_level == INTR_ON || intr_context ())
+    thread_preempt ();
+}
+
+/* Yields the CPU if a ready thread has a higher priority than the
+   running thread.  In an interrupt handler, yields when the
+   handler returns. */
+void
+thread_preempt (void)
+{
+  enum intr_level old_level;
+  struct thread *cur;
+  bool yield;
+
+  /* The stride scheduler does not go by priority. */
+  if (thread_stride)
+    return;
+
+  old_level = intr_disable ();
+  cur = running_thread ();
+  yield = cur != idle_thread && ready_max_priority () > cur->priority;
+  intr_set_level (old_level);
+
+  if (yield)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield_preempted ();
+    }
+}
+
+/* Yields the CPU like thread_yield(), but on behalf of a thread
+   that should run instead of the current one, so that the switch
+   counts as involuntary. */
+void
+thread_yield_preempted (void)
+{
+  yield (true);
 }
 
 /* Returns the name of the running thread. */
@@ -324,7 +581,10 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   DEBUG_thread_exited();
+  malloc_thread_exit ();
   intr_disable ();
+  add_stats (&exited_stats, &thread_current ()->stats);
+  list_remove (&thread_current ()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -335,6 +595,16 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void)
+{
+  yield (false);
+}
+
+/* Does the work of thread_yield() and thread_yield_preempted().
+   PREEMPTED says whether the switch counts as involuntary.  It is
+   recorded only once interrupts are off, so that a timer
+   interrupt that preempts the thread first cannot clear it. */
+static void
+yield (bool preempted)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -342,18 +612,103 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  preempting = preempted;
   if (cur != idle_thread)
-    list_push_back (&ready_list, &cur->elem);
+    {
+      cur->stats.ready_since = timer_ticks ();
+      ready_push (cur);
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY, and
+   yields if it no longer has the highest priority.  Priorities
+   donated to the thread stay in effect until it releases the
+   locks they were donated through.  Ignored under -mlfqs, which
+   computes priorities itself. */
 void
 thread_set_priority (int new_priority)
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Raises T's priority to PRIORITY, if it is lower, on behalf of a
+   thread waiting for a lock T holds.  Interrupts must be off. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->priority < priority)
+    set_priority (t, priority);
+}
+
+/* Recomputes T's priority as the highest of its own priority and
+   those of the threads waiting for the locks T holds.
+   Interrupts must be off. */
+void
+thread_update_priority (struct thread *t)
+{
+  int priority = t->base_priority;
+  struct list_elem *le, *we;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (le = list_begin (&t->held_locks); le != list_end (&t->held_locks);
+       le = list_next (le))
+    {
+      struct list *waiters = &list_entry (le, struct lock, elem)
+                                ->semaphore.waiters;
+      for (we = list_begin (waiters); we != list_end (waiters);
+           we = list_next (we))
+        {
+          struct thread *w = list_entry (we, struct thread, elem);
+          if (w->priority > priority)
+            priority = w->priority;
+        }
+    }
+  if (t->priority != priority)
+    set_priority (t, priority);
+}
+
+/* Returns true if thread A has lower priority than thread B.
+   Suitable for list_max() on lists of threads. */
+bool
+thread_priority_less (const struct list_elem *a_, const struct list_elem *b_,
+                      void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+  return a->priority < b->priority;
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the right
+   ready queue if it is ready.  Interrupts must be off. */
+static void
+set_priority (struct thread *t, int priority)
+{
+  if (t->status == THREAD_READY && !thread_stride)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
 }
 
 /* Returns the current thread's priority. */
@@ -363,37 +718,134 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, and yields if
+   its new priority is no longer the highest. */
 void
-thread_set_nice (int nice UNUSED)
+thread_set_nice (int nice)
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent;
 }
-
+
+/* Does the per-tick MLFQS bookkeeping for T, the running thread.
+   Runs in the timer interrupt handler. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  if (t != idle_thread)
+    t->recent_cpu += FP_ONE;
+
+  if (now % TIMER_FREQ == 0)
+    mlfqs_second ();
+  else if (now % MLFQS_PRI_TICKS == 0 && t != idle_thread)
+    mlfqs_update_priority (t);
+
+  if (ready_max_priority () > t->priority)
+    intr_yield_on_return ();
+}
+
+/* Recomputes load_avg, and recent_cpu and priority of every
+   thread.  Interrupts must be off. */
+static void
+mlfqs_second (void)
+{
+  struct thread *cur = running_thread ();
+  int ready_threads = ready_cnt + (cur != idle_thread);
+  fixed_point decay;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  load_avg = (fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+              + fp_from_int (ready_threads) / 60);
+  decay = fp_div (2 * load_avg, 2 * load_avg + FP_ONE);
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t == idle_thread)
+        continue;
+      t->recent_cpu = fp_mul (decay, t->recent_cpu) + fp_from_int (t->nice);
+      mlfqs_update_priority (t);
+    }
+}
+
+/* Sets T's priority to PRI_MAX - recent_cpu / 4 - nice * 2,
+   truncated to an integer and clamped to the valid range. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  t->base_priority = priority;
+  if (t->priority != priority)
+    set_priority (t, priority);
+}
+
+/* Sets the current thread's ticket count to TICKETS.  Returns
+   false, without changing anything, if TICKETS is out of range. */
+bool
+thread_set_tickets (int tickets)
+{
+  if (tickets < TICKETS_MIN || tickets > TICKETS_MAX)
+    return false;
+  thread_current ()->tickets = tickets;
+  return true;
+}
+
+/* Returns the current thread's ticket count. */
+int
+thread_get_tickets (void)
+{
+  return thread_current ()->tickets;
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -415,6 +867,7 @@ idle (void *idle_started_ UNUSED)
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
+      timer_idle_enter ();
 
       /* Re-enable interrupts and wait for the next one.
 
@@ -477,18 +930,132 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Adds T to the back of the ready queue for its priority.
+   Interrupts must be off. */
+static void
+ready_push (struct thread *t)
+{
+  if (thread_stride)
+    stride_push (t);
+  else
+    {
+      list_push_back (&ready_queues[t->priority], &t->elem);
+      ready_mask |= (uint64_t) 1 << t->priority;
+    }
+  ready_cnt++;
+}
+
+/* Adds T to the stride scheduler's heap.  Interrupts must be
+   off. */
+static void
+stride_push (struct thread *t)
+{
+  size_t i = stride_heap_cnt++;
+
+  ASSERT (i < STRIDE_HEAP_MAX);
+  while (i > 0)
+    {
+      size_t parent = (i - 1) / 2;
+      if (stride_heap[parent]->pass <= t->pass)
+        break;
+      stride_heap[i] = stride_heap[parent];
+      i = parent;
+    }
+  stride_heap[i] = t;
+}
+
+/* Removes and returns the thread with the lowest pass from the
+   stride scheduler's heap, which must not be empty.  Interrupts
+   must be off. */
+static struct thread *
+stride_pop (void)
+{
+  struct thread *min = stride_heap[0];
+  struct thread *last = stride_heap[--stride_heap_cnt];
+  size_t i = 0;
+
+  for (;;)
+    {
+      size_t child = 2 * i + 1;
+      if (child >= stride_heap_cnt)
+        break;
+      if (child + 1 < stride_heap_cnt
+          && stride_heap[child + 1]->pass < stride_heap[child]->pass)
+        child++;
+      if (last->pass <= stride_heap[child]->pass)
+        break;
+      stride_heap[i] = stride_heap[child];
+      i = child;
+    }
+  stride_heap[i] = last;
+  return min;
+}
+
+/* Removes ready thread T from its ready queue.  Interrupts must
+   be off. */
+static void
+ready_remove (struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_mask &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready.  Interrupts must be off.
+
+   Uses the bit scan instruction on the half of ready_mask that
+   holds the highest set bit, which __builtin_clz() compiles to
+   without a library call. */
+static int
+ready_max_priority (void)
+{
+  uint32_t high = ready_mask >> 32;
+  uint32_t low = ready_mask;
+
+  if (high != 0)
+    return 63 - __builtin_clz (high);
+  else if (low != 0)
+    return 31 - __builtin_clz (low);
+  else
+    return -1;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   idle_thread.
+
+   Returns the first thread in the highest-priority nonempty
+   ready queue, or under -stride the thread with the lowest
+   pass. */
 static struct thread *
 next_thread_to_run (void)
 {
-  if (list_empty (&ready_list))
+  int pri;
+  struct list *queue;
+  struct thread *t;
+
+  if (thread_stride)
+    {
+      if (stride_heap_cnt == 0)
+        return idle_thread;
+      t = stride_pop ();
+      ready_cnt--;
+      stride_pass = t->pass;
+      return t;
+    }
+
+  pri = ready_max_priority ();
+  if (pri < 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  queue = &ready_queues[pri];
+  t = list_entry (list_front (queue), struct thread, elem);
+  ready_remove (t);
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -517,6 +1084,20 @@ schedule_tail (struct thread *prev)
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
+  /* Record how long we waited in the ready queue. */
+  if (prev != NULL && cur != idle_thread)
+    {
+      int64_t wait = timer_ticks () - cur->stats.ready_since;
+      int bucket = 0;
+      while (wait > 0 && bucket < WAIT_HIST_CNT - 1)
+        {
+          wait >>= 1;
+          bucket++;
+        }
+      cur->stats.wait_hist[bucket]++;
+      cur->stats.switches++;
+    }
+
   /* Start new time slice. */
   thread_ticks = 0;
 
@@ -555,6 +1136,16 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur == idle_thread && next != idle_thread)
+    timer_idle_exit ();
+  if (cur != next)
+    {
+      if (cur->status == THREAD_READY && preempting)
+        cur->stats.involuntary++;
+      else
+        cur->stats.voluntary++;
+    }
+  preempting = false;
   if (cur != next)
     prev = switch_threads (cur, next);
   schedule_tail (prev);
@@ -618,6 +1209,17 @@ void DEBUG_thread_exited(void)
   lock_release(&DEBUG_thread_alive_lock);
 }
 
+/* Called by kernel threads that run until the machine is powered
+   off, such as the file system's background workers.  They will
+   never exit, so power_off() must not wait for them. */
+void DEBUG_thread_daemon(void)
+{
+  lock_acquire(&DEBUG_thread_alive_lock);
+  --DEBUG_thread_alive_count;
+  cond_broadcast(&DEBUG_thread_alive_cond, &DEBUG_thread_alive_lock);
+  lock_release(&DEBUG_thread_alive_lock);
+}
+
 void DEBUG_thread_poweroff_check(bool force_off)
 {
   lock_acquire(&DEBUG_thread_alive_lock);
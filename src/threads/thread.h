@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/malloc.h"
 #include "userprog/plist.h"
 #include "userprog/flist.h"
 
@@ -26,6 +27,24 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Number of buckets in a thread's ready-queue wait histogram.
+   Bucket 0 counts waits of 0 ticks, bucket I > 0 waits of
+   2**(I-1) to 2**I - 1 ticks, and the last bucket also counts all
+   longer waits. */
+#define WAIT_HIST_CNT 8
+
+/* Scheduling statistics of a thread. */
+struct thread_stats
+  {
+    int64_t run_ticks;                  /* Timer ticks spent running. */
+    unsigned switches;                  /* Times switched to. */
+    unsigned voluntary;                 /* Switches away by blocking or
+                                           yielding. */
+    unsigned involuntary;               /* Switches away by preemption. */
+    int64_t ready_since;                /* Tick it last became ready. */
+    unsigned wait_hist[WAIT_HIST_CNT];  /* Ready-queue waits. */
+  };
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -89,10 +108,25 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority set by the thread. */
+    int nice;                           /* Niceness, for -mlfqs. */
+    int recent_cpu;                     /* Recent CPU time (17.14), -mlfqs. */
+    struct list_elem allelem;           /* Element in all threads list. */
+    int tickets;                        /* CPU share, for -stride. */
+    int64_t pass;                       /* Stride scheduler pass value. */
+    struct thread_stats stats;          /* Scheduling statistics. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for, or NULL. */
+
+    /* Owned by threads/malloc.c. */
+    struct magazine magazines[MAGAZINE_CLASS_CNT]; /* Free blocks. */
+
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if asleep. */
 
     /* YES! You may want to add stuff. But make note of point 2 above. */
     map_t open_files;
@@ -103,6 +137,19 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 //#endif
+#ifdef VM
+    struct file *exec_file;             /* Executable, kept open. */
+
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    struct list pinned_pages;           /* Pages pinned by a syscall. */
+    void *user_esp;                     /* User stack pointer at the last
+                                           syscall or user page fault. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -113,17 +160,37 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride scheduler, which gives each thread CPU
+   time in proportion to its tickets.
+   Controlled by kernel command-line option "-stride". */
+extern bool thread_stride;
+
+/* Range of ticket counts for the stride scheduler. */
+#define TICKETS_MIN 1
+#define TICKETS_DEFAULT 100
+#define TICKETS_MAX 10000
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_idle_ticks (int64_t);
+bool thread_get_stats (tid_t, struct thread_stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_daemon (const char *name, int priority,
+                            thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_preempt (void);
+void thread_yield_preempted (void);
+void thread_donate_priority (struct thread *, int priority);
+void thread_update_priority (struct thread *);
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -140,10 +207,14 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+bool thread_set_tickets (int);
+int thread_get_tickets (void);
+
 void DEBUG_thread_init (void);
 void DEBUG_thread_created (void);
 void DEBUG_thread_prepare_exit (void);
 void DEBUG_thread_exited (void);
+void DEBUG_thread_daemon (void);
 void DEBUG_thread_poweroff_check (bool force_off);
 bool DEBUG_thread_create_simulate_fail (void);
 
@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,6 +152,16 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Read in the page if it belongs to the process, or grow the
+     stack.  A fault in the kernel happens during a system call,
+     which saved the user stack pointer on entry. */
+  if (user)
+    thread_current ()->user_esp = f->esp;
+  if (not_present && is_user_vaddr (fault_addr) && page_in (fault_addr))
+    return;
+#endif
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
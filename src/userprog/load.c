@@ -11,6 +11,9 @@
 #include "threads/palloc.h" /* PAL_* constants */
 #include "threads/thread.h"
 #include "threads/vaddr.h"  /* PGSIZE */
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
@@ -101,6 +104,12 @@ load (const char *file_name, void (**eip) (void), void **esp)
     goto done;
   process_activate ();
 
+#ifdef VM
+  /* Create supplemental page table. */
+  if (!page_table_create ())
+    goto done;
+#endif
+
   /* Set up stack. */
   if (!setup_stack (esp)){
     goto done;
@@ -191,6 +200,15 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
   success = true;
 
+#ifdef VM
+  /* Keep the executable open to read its pages from, and deny
+     writes to it while it runs, so that pages not read in yet
+     keep the contents of the pages already read. */
+  file_deny_write (file);
+  t->exec_file = file;
+  file = NULL;
+#endif
+
  done:
   /* We arrive here whether the load is successful or not. */
   file_close (file);
@@ -199,7 +217,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -258,6 +278,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table, to be read in when first accessed.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -267,9 +290,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t page_offset
   ASSERT ((page_offset + read_bytes + zero_bytes) % PGSIZE == 0);
   ASSERT (pg_ofs (upage) == 0);
 
+#ifndef VM
   struct thread *t = thread_current();
 
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0)
     {
       /* Calculate how to fill this page.
@@ -280,6 +305,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t page_offset
 		  page_read_bytes = PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      if (!page_add_file (upage, file, ofs, page_offset,
+                          page_read_bytes - page_offset, writable))
+        return false;
+      ofs += page_read_bytes - page_offset;
+#else
+
       /* Get a page of memory.
 	   * If it was present previously at the indicated address in userspace, then we use that. */
 	  bool new_kpage = false;
@@ -310,6 +343,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t page_offset
 			  return false;
 		    }
 	    }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes - page_offset;
@@ -325,6 +359,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t page_offset
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (!page_add_zero (upage, true) || !page_in (upage))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -338,8 +380,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -359,6 +403,7 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
 
 /* A function that dumps 'size' bytes of memory starting at 'ptr'
  * it will dump the higher adress first letting the stack grow down.
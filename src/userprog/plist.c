@@ -6,15 +6,16 @@
 #include <stdbool.h>
 #include "plist.h"
 #include "../filesys/file.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 
 struct plist global_plist;
 struct lock plist_lock;
+static struct kmem_cache *process_cache; /* Cache of struct process. */
 
 bool new_process_init(tid_t t, int processid)
 {
-    value_ptr_t p = malloc(sizeof(struct process));
+    value_ptr_t p = kmem_cache_alloc(process_cache);
     if (p == NULL)
     {
         //fprintf(stderr, "Error: Memory allocation failed in process_init\n");
@@ -35,7 +36,7 @@ bool new_process_init(tid_t t, int processid)
     int success = plist_insert(p);
     if ( success == -1)
     {
-        free(p);
+        kmem_cache_free(process_cache, p);
         return false;
     } // insert the process into the global plist
     return true;
@@ -48,6 +49,9 @@ void plist_init()
         global_plist.content[i] = NULL; // init all pointers to NULL
     }
     lock_init(&plist_lock);
+    process_cache = kmem_cache_create("process", sizeof(struct process), NULL);
+    if (process_cache == NULL)
+        PANIC("process cache creation failed");
 }
 
 
@@ -99,7 +103,7 @@ void plist_remove(tid_t t)
         {
             if (global_plist.content[i] != NULL && global_plist.content[i]->tid == t)
             {
-                free(p); 
+                kmem_cache_free(process_cache, p);
                 global_plist.content[i] = NULL;
                 break;
             }
@@ -118,12 +122,22 @@ void plist_print()
         if(global_plist.content[i] != NULL)
         {
             struct process* p = global_plist.content[i];
+            struct thread_stats st;
             debug("Process ID: %-5d  Parent ID: %-5d  Alive: %-3s  ParentAlive: %-3s  Status: %-3d\n",
                 p->tid,
                 p->parentid,
                 p->alive ? "Yes" : "No",
                 p->parent_alive ? "Yes" : "No",
                 p->status);
+            if (thread_get_stats(p->tid, &st))
+            {
+                debug("    Ticks: %-6lld  Switches: %-5u  Voluntary: %-5u  Involuntary: %-5u\n",
+                    st.run_ticks, st.switches, st.voluntary, st.involuntary);
+                debug("    Ready wait (ticks) <1:%u <2:%u <4:%u <8:%u <16:%u <32:%u <64:%u >=64:%u\n",
+                    st.wait_hist[0], st.wait_hist[1], st.wait_hist[2],
+                    st.wait_hist[3], st.wait_hist[4], st.wait_hist[5],
+                    st.wait_hist[6], st.wait_hist[7]);
+            }
             count++;
         }
     }
@@ -21,6 +21,10 @@
 
 #include "userprog/flist.h"
 #include "userprog/plist.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 /* HACK defines code you must remove and implement in a proper way */
 #define HACK
@@ -313,6 +317,17 @@ void process_cleanup(void)
       }
    }
 
+#ifdef VM
+   /* Write back memory-mapped files, then free the frames and swap
+      slots of the process's pages while its page directory still
+      maps them.  This must be done before the parent is told that
+      we exit, so that it sees the files' new contents and cannot
+      power off first. */
+   mmap_unmap_all();
+   page_table_destroy();
+   file_close(cur->exec_file);
+   cur->exec_file = NULL;
+#endif
 
    /* Later tests DEPEND on this output to work correct. You will have
     * to find the actual exit status in your process list. It is
@@ -16,6 +16,10 @@
 #include "lib/user/syscall.h"
 
 #include "devices/timer.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static void syscall_handler(struct intr_frame *);
 
@@ -25,6 +29,18 @@ void syscall_init(void)
 }
 
 
+/* Returns true if the page containing ADDR is mapped in the
+   current process, reading it in first if it is not loaded yet.
+   With VM, the page stays pinned until the system call returns. */
+static bool page_present(const void* addr)
+{
+#ifdef VM
+  return page_pin(addr);
+#else
+  return pagedir_get_page(thread_current()->pagedir, addr) != NULL;
+#endif
+}
+
 bool verify_fix_length(void* start, unsigned length)
 {
   if (is_kernel_vaddr(start) || is_kernel_vaddr((void*)((unsigned)start + length - 1)))
@@ -36,7 +52,7 @@ bool verify_fix_length(void* start, unsigned length)
   
   for (unsigned i = pg_no(pg_round_down(start)); i <= end; i++)
   {
-    if (pagedir_get_page(thread_current()->pagedir, (void*)(i*PGSIZE)) == NULL)   
+    if (!page_present((void*)(i*PGSIZE)))
     {
       return false;
     }
@@ -56,7 +72,7 @@ bool verify_variable_length(char* start)
     if (current_page != pg_no(addr))
     {
       current_page = pg_no(addr);
-      if ( is_kernel_vaddr(addr) || pagedir_get_page(thread_current()->pagedir, addr) == NULL)   
+      if ( is_kernel_vaddr(addr) || !page_present(addr))
       {
         return false;
       }
@@ -82,16 +98,24 @@ bool verify_variable_length(char* start)
 const int argc[] = {
     /* basic calls */
     0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1,
+    /* memory mapping */
+    2, 1,
     /* not implemented */
-    2, 1, 1, 1, 2, 1, 1,
+    1, 1, 2, 1, 1,
     /* extended, you may need to change the order of these two (plist, sleep) */
-    0, 1};
+    0, 1,
+    /* tickets */
+    1};
 
 static void
 syscall_handler(struct intr_frame *f)
 {
   int32_t *esp = (int32_t *)f->esp;
-  
+#ifdef VM
+  /* Accesses to user buffers on the stack may need to grow it. */
+  thread_current()->user_esp = f->esp;
+#endif
+
   if (!verify_fix_length(esp, sizeof(int32_t))) {
     process_exit(-1);
   }
@@ -317,6 +341,23 @@ syscall_handler(struct intr_frame *f)
     f->eax = file_tell(file);
     break;
   }
+  case SYS_MMAP: // int fd, void *addr
+  {
+#ifdef VM
+    struct file *file = map_find(&thread_current()->open_files, arg1);
+    f->eax = file != NULL ? mmap_map(file, (void*)arg2) : -1;
+#else
+    f->eax = -1;
+#endif
+    break;
+  }
+  case SYS_MUNMAP: // mapid_t mapping
+  {
+#ifdef VM
+    mmap_unmap(arg1);
+#endif
+    break;
+  }
   case SYS_PLIST: // void
   {
     plist_print();
@@ -329,6 +370,12 @@ syscall_handler(struct intr_frame *f)
     break;
   }
 
+  case SYS_TICKETS: // int tickets
+  {
+    f->eax = thread_set_tickets(arg1) ? 0 : -1;
+    break;
+  }
+
   default:
   {
     printf("Executed an unknown system call!\n");
@@ -339,4 +386,7 @@ syscall_handler(struct intr_frame *f)
     thread_exit();
   }
   }
+#ifdef VM
+  page_unpin_all();
+#endif
 }
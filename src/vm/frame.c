@@ -0,0 +1,319 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Frame table.
+
+   Every user pool page that holds a process's page is in the
+   frame table.  When the user pool runs out, a frame is taken
+   from another page by the clock algorithm: the clock hand
+   sweeps the table, clearing the accessed bits of the pages in
+   each frame it passes, and evicts the pages of the first
+   unpinned frame whose bits were already clear, i.e. one that
+   was not touched during the last sweep.
+
+   Read-only executable pages are shared.  The shared frames are
+   also in a hash table keyed by inode and file offset, where a
+   process that faults on such a page finds the frame if another
+   process already read the page in.  A shared frame is freed
+   when the last page mapped to it goes away.  The key is never
+   stale: every page mapped to the frame belongs to a process
+   running the executable, which denies writes to it, and the
+   inode stays open as long as such a process exists.
+
+   A single lock protects the frame tables and the `frame'
+   members of all pages, so that a page cannot be evicted while
+   it is being freed or pinned.  It is held while an evicted page
+   is written out, which keeps eviction simple at the cost of
+   serializing page faults behind it. */
+
+static struct list frames;              /* All frames. */
+static struct list_elem *hand;          /* Clock hand. */
+static struct hash shared_frames;       /* Shared frames. */
+static struct lock frame_lock;          /* Protects the frame tables. */
+static struct kmem_cache *frame_cache;  /* Cache of `struct frame's. */
+
+static long long evict_cnt;             /* Number of evictions. */
+
+static struct frame *evict (void);
+static void attach (struct frame *, struct page *);
+static hash_hash_func frame_hash;
+static hash_less_func frame_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  if (!hash_init (&shared_frames, frame_hash, frame_less, NULL))
+    PANIC ("shared frame table creation failed");
+  lock_init (&frame_lock);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+  if (frame_cache == NULL)
+    PANIC ("frame cache creation failed");
+}
+
+/* Obtains a private frame for PAGE, which must belong to the
+   current thread, evicting other pages if the user pool is
+   exhausted.  Sets PAGE's frame and returns it, pinned.  Returns
+   a null pointer if no frame can be obtained. */
+struct frame *
+frame_alloc (struct page *page)
+{
+  struct frame *f = NULL;
+  void *kpage;
+
+  ASSERT (page->frame == NULL);
+
+  lock_acquire (&frame_lock);
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f == NULL)
+        palloc_free_page (kpage);
+      else
+        {
+          f->kpage = kpage;
+          list_init (&f->pages);
+          list_push_back (&frames, &f->elem);
+        }
+    }
+  else
+    f = evict ();
+
+  if (f != NULL)
+    {
+      f->pin_cnt = 0;
+      f->inode = NULL;
+      attach (f, page);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Looks for the shared frame holding the page at FILE_OFS in
+   executable INODE.  If there is one, maps PAGE to it and returns
+   it, pinned.  Otherwise, returns a null pointer. */
+struct frame *
+frame_find_shared (struct page *page, struct inode *inode, off_t file_ofs)
+{
+  struct frame key, *f = NULL;
+  struct hash_elem *e;
+
+  ASSERT (page->frame == NULL);
+
+  lock_acquire (&frame_lock);
+  key.inode = inode;
+  key.file_ofs = file_ofs;
+  e = hash_find (&shared_frames, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      attach (f, page);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Makes PAGE's frame, which holds the page at FILE_OFS in
+   executable INODE, available to other processes running the
+   executable.  Does nothing if another frame already holds that
+   page. */
+void
+frame_share (struct page *page, struct inode *inode, off_t file_ofs)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = page->frame;
+  ASSERT (f != NULL && f->inode == NULL);
+  f->inode = inode;
+  f->file_ofs = file_ofs;
+  if (hash_insert (&shared_frames, &f->share_elem) != NULL)
+    f->inode = NULL;
+  lock_release (&frame_lock);
+}
+
+/* Unmaps PAGE from its frame, if it has one, and frees the frame
+   if no other page is mapped to it. */
+void
+frame_free (struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = page->frame;
+  if (f != NULL)
+    {
+      pagedir_clear_page (page->thread->pagedir, page->upage);
+      list_remove (&page->frame_elem);
+      page->frame = NULL;
+
+      if (list_empty (&f->pages))
+        {
+          if (f->inode != NULL)
+            hash_delete (&shared_frames, &f->share_elem);
+          if (hand == &f->elem)
+            hand = list_next (hand);
+          list_remove (&f->elem);
+          palloc_free_page (f->kpage);
+          kmem_cache_free (frame_cache, f);
+        }
+    }
+  lock_release (&frame_lock);
+}
+
+/* Pins PAGE's frame so that it is not evicted.  Returns true if
+   successful, false if PAGE is not in a frame. */
+bool
+frame_pin (struct page *page)
+{
+  bool pinned = false;
+
+  lock_acquire (&frame_lock);
+  if (page->frame != NULL)
+    {
+      page->frame->pin_cnt++;
+      pinned = true;
+    }
+  lock_release (&frame_lock);
+  return pinned;
+}
+
+/* Undoes one frame_pin() of PAGE's frame, or the pin of the
+   frame returned by frame_alloc() or frame_find_shared(). */
+void
+frame_unpin (struct page *page)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (page->frame != NULL && page->frame->pin_cnt > 0);
+  page->frame->pin_cnt--;
+  lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %zu shared, %lld evictions\n",
+          list_size (&frames), hash_size (&shared_frames), evict_cnt);
+}
+
+/* Maps PAGE to frame F and pins F.  The frame lock must be
+   held. */
+static void
+attach (struct frame *f, struct page *page)
+{
+  list_push_back (&f->pages, &page->frame_elem);
+  f->pin_cnt++;
+  page->frame = f;
+}
+
+/* Advances the clock hand and returns the frame it passes. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Returns true if any page in frame F was accessed since the
+   last call, and clears their accessed bits. */
+static bool
+test_and_clear_accessed (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Chooses a frame by the clock algorithm, evicts its pages, and
+   returns the frame, still in the frame table but with no pages
+   and out of the shared frame table.  Returns a null pointer if
+   every frame is pinned or no page could be written out.  The
+   frame lock must be held. */
+static struct frame *
+evict (void)
+{
+  size_t i, n = 2 * list_size (&frames);
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* Two sweeps visit every unpinned frame once with its accessed
+     bits set and once with them clear. */
+  for (i = 0; i < n; i++)
+    {
+      struct frame *f = clock_next ();
+      struct list_elem *e;
+
+      if (f->pin_cnt > 0 || test_and_clear_accessed (f))
+        continue;
+
+      /* Only a private page can need swap, so if writing one out
+         fails, the frame has no other pages to restore. */
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        if (!page_out (list_entry (e, struct page, frame_elem)))
+          break;
+      if (e != list_end (&f->pages))
+        continue;
+
+      while (!list_empty (&f->pages))
+        {
+          struct page *p = list_entry (list_pop_front (&f->pages),
+                                       struct page, frame_elem);
+          p->frame = NULL;
+        }
+      if (f->inode != NULL)
+        hash_delete (&shared_frames, &f->share_elem);
+      evict_cnt++;
+      return f;
+    }
+  return NULL;
+}
+
+/* Returns a hash value for shared frame E. */
+static unsigned
+frame_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->file_ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+frame_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->file_ofs < b->file_ofs;
+}
@@ -0,0 +1,42 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A frame of the user pool holding a page.
+
+   A frame normally holds a single process's page.  A read-only
+   page of an executable is instead shared by all the processes
+   that run the executable while it is in memory: its frame is
+   found by the executable's inode and the page's offset in it,
+   and it holds a page of each of those processes. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped to this frame. */
+    int pin_cnt;                /* Not to be evicted if nonzero. */
+    struct list_elem elem;      /* Element in frame table. */
+
+    /* Shared frames only. */
+    struct inode *inode;        /* Executable, or null if private. */
+    off_t file_ofs;             /* Offset of the page in INODE. */
+    struct hash_elem share_elem; /* Element in shared frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_find_shared (struct page *, struct inode *,
+                                 off_t file_ofs);
+void frame_share (struct page *, struct inode *, off_t file_ofs);
+void frame_free (struct page *);
+bool frame_pin (struct page *);
+void frame_unpin (struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
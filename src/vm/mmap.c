@@ -0,0 +1,136 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping makes the pages of a file appear in a process's
+   address space starting at a page boundary.  The pages are
+   added to the supplemental page table and read in on first
+   access like those of an executable.  Modified pages are
+   written back to the file, not to swap, when they are evicted,
+   and when the mapping is removed by munmap or process exit.
+   The last page is only written back up to the end of the file,
+   so a mapping never changes the file's length. */
+
+/* A memory mapping. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's mappings. */
+    int id;                     /* Mapping identifier. */
+    struct file *file;          /* Mapped file, reopened. */
+    uint8_t *base;              /* Start of mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+  };
+
+/* Removes the first PAGE_CNT pages of mapping M from the current
+   thread's address space, writing back modified pages. */
+static void
+unmap_pages (struct mapping *m, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+}
+
+/* Maps FILE into the current thread's address space starting at
+   ADDR.  Returns the new mapping's identifier, or -1 if ADDR is
+   null or not page-aligned, FILE is empty, the mapping would
+   overlap pages already in use or the stack's reserved range, or
+   memory is not available. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return -1;
+  length = file_length (file);
+  if (length <= 0)
+    return -1;
+  if ((uintptr_t) addr + length < (uintptr_t) addr
+      || (uint8_t *) addr + length
+         > (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      if (!page_add_mmap (m->base + ofs, m->file, ofs, read_bytes))
+        {
+          unmap_pages (m, i);
+          file_close (m->file);
+          free (m);
+          return -1;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Removes mapping M, writing back its modified pages. */
+static void
+unmap (struct mapping *m)
+{
+  list_remove (&m->elem);
+  unmap_pages (m, m->page_cnt);
+  file_close (m->file);
+  free (m);
+}
+
+/* Removes the current thread's mapping MAPID, writing back its
+   modified pages.  Does nothing if there is no such mapping. */
+void
+mmap_unmap (int mapid)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapid)
+        {
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Removes all of the current thread's mappings.  Called when a
+   process exits. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
@@ -0,0 +1,484 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Pages of an executable are not read when it is loaded.
+   Instead, load() records for each page where its contents are
+   in the file, and the page fault handler reads a page in the
+   first time the process touches it, so that starting a process
+   costs the same no matter how large its executable is.
+
+   A page that is in memory is in a frame (see frame.c), from
+   which it may be evicted.  An evicted page that was modified is
+   written to swap and read back from there; one that was not is
+   read again from its file or zeroed.  Once a page has been in
+   swap, its file no longer has its contents, so after it is read
+   back it is marked dirty to make the next eviction write it to
+   swap again.
+
+   Pages of memory-mapped files are written back to their file
+   instead of to swap.
+
+   A full read-only page of the executable always has the
+   contents of the file, so it is shared with the other processes
+   running the same executable through the frame table.
+
+   The stack starts out as a single page and grows on demand: an
+   access to a missing page just below the stack pointer, or
+   anywhere above it, within the stack size limit, adds a zeroed
+   page there.  A process thus only pays for as much stack as it
+   has used.
+
+   System calls pin the user pages they access, so that the
+   kernel does not fault on them while it holds file system
+   locks.  Pinned pages are unpinned by page_unpin_all() when the
+   system call returns.
+
+   Each process's table is a hash table of `struct page's keyed
+   by user virtual address.  The table itself is only used by the
+   process's own thread, so it needs no locking, but the frame
+   table lock protects each page's FRAME and, while it is in a
+   frame, SWAP_SLOT, since eviction by another thread changes
+   them. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void unpin (struct page *);
+static struct page *find_page (const void *addr);
+static struct page *new_page (void *upage, struct file *, off_t file_ofs,
+                              size_t page_ofs, size_t read_bytes,
+                              bool writable, bool write_back);
+
+/* Maximum size of a process's stack, in pages.  Controlled by
+   kernel command-line option "-sl". */
+size_t stack_page_limit = 2048;
+
+/* Creates an empty supplemental page table for the current
+   thread.  Returns true if successful, false if memory is not
+   available. */
+bool
+page_table_create (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL))
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  list_init (&t->pinned_pages);
+  return true;
+}
+
+/* Frees a page table entry along with its frame and swap slot.
+   Used as a hash_action_func. */
+static void
+free_page (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  frame_free (p);
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  free (p);
+}
+
+/* Destroys the current thread's supplemental page table, if it
+   has one, and frees the frames and swap slots of its pages.
+   Must be called before the thread's page directory is
+   destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL)
+    {
+      page_unpin_all ();
+      hash_destroy (t->pages, free_page);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Returns the current thread's page containing ADDR, or a null
+   pointer if there is none. */
+static struct page *
+page_lookup (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page key;
+  struct hash_elem *e;
+
+  if (t->pages == NULL)
+    return NULL;
+  key.upage = pg_round_down (addr);
+  e = hash_find (t->pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Returns true if ADDR may be an access to the current thread's
+   stack, whose stack pointer is ESP.  PUSHA checks the lowest of
+   the 32 bytes it pushes before it moves the stack pointer, so
+   accesses up to 32 bytes below ESP count too. */
+static bool
+is_stack_access (const void *addr, const void *esp)
+{
+  const uint8_t *stack_bottom = (uint8_t *) PHYS_BASE
+                                - stack_page_limit * PGSIZE;
+
+  return (is_user_vaddr (addr)
+          && (const uint8_t *) addr >= stack_bottom
+          && (const uint8_t *) addr + 32 >= (const uint8_t *) esp);
+}
+
+/* Returns the current thread's page containing ADDR.  If there is
+   none but ADDR looks like an access to the stack, adds a zeroed
+   page there first.  Returns a null pointer if ADDR is not in a
+   page of the process or memory is not available. */
+static struct page *
+find_page (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (addr);
+
+  if (p == NULL && t->pages != NULL && is_stack_access (addr, t->user_esp)
+      && page_add_zero (pg_round_down (addr), true))
+    p = page_lookup (addr);
+  return p;
+}
+
+/* Reads page P's initial contents into KPAGE.  Returns true if
+   successful, false on a read error. */
+static bool
+load_page (struct page *p, uint8_t *kpage)
+{
+  ASSERT (p->file != NULL || p->read_bytes == 0);
+
+  if (p->file != NULL
+      && file_read_at (p->file, kpage + p->page_ofs, p->read_bytes,
+                       p->file_ofs) != (off_t) p->read_bytes)
+    return false;
+  memset (kpage, 0, p->page_ofs);
+  memset (kpage + p->page_ofs + p->read_bytes, 0,
+          PGSIZE - p->page_ofs - p->read_bytes);
+  return true;
+}
+
+/* Adds page UPAGE to the current thread's page table, with the
+   given members, and returns it.  Returns a null pointer if
+   memory is not available. */
+static struct page *
+new_page (void *upage, struct file *file, off_t file_ofs, size_t page_ofs,
+          size_t read_bytes, bool writable, bool write_back)
+{
+  struct thread *t = thread_current ();
+  struct page *p = malloc (sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+  p->thread = t;
+  p->upage = upage;
+  p->writable = writable;
+  p->file = read_bytes > 0 || write_back ? file : NULL;
+  p->file_ofs = file_ofs;
+  p->page_ofs = page_ofs;
+  p->read_bytes = read_bytes;
+  p->write_back = write_back;
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->pinned = false;
+  hash_insert (t->pages, &p->elem);
+  return p;
+}
+
+/* Adds page UPAGE to the current thread's page table, to be
+   loaded on first access with READ_BYTES bytes of FILE starting
+   at FILE_OFS, placed PAGE_OFS bytes into the page, and zeroes
+   elsewhere.  FILE must stay open as long as the page exists.
+
+   Adjacent segments of an executable may share a page.  If UPAGE
+   already exists, its current contents are loaded and the new
+   bytes are read into it right away instead.
+
+   Returns true if successful, false if memory is not available
+   or on a read error. */
+bool
+page_add_file (void *upage, struct file *file, off_t file_ofs,
+               size_t page_ofs, size_t read_bytes, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (page_ofs + read_bytes <= PGSIZE);
+
+  p = page_lookup (upage);
+  if (p != NULL)
+    {
+      uint8_t *kpage;
+      bool ok;
+
+      /* The page's contents are no longer those of one file
+         region, so keep them in memory or swap from now on. */
+      if (!page_pin (upage))
+        return false;
+      p->file = NULL;
+      kpage = p->frame->kpage;
+      ok = (file_read_at (file, kpage + page_ofs, read_bytes, file_ofs)
+            == (off_t) read_bytes);
+      p->writable = p->writable || writable;
+      pagedir_clear_page (t->pagedir, upage);
+      ok = ok && pagedir_set_page (t->pagedir, upage, kpage, p->writable);
+      pagedir_set_dirty (t->pagedir, upage, true);
+      unpin (p);
+      return ok;
+    }
+
+  return new_page (upage, file, file_ofs, page_ofs, read_bytes,
+                   writable, false) != NULL;
+}
+
+/* Adds the all-zero page UPAGE to the current thread's page
+   table.  Returns true if successful, false if memory is not
+   available or UPAGE already exists. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  if (page_lookup (upage) != NULL)
+    return false;
+  return page_add_file (upage, NULL, 0, 0, 0, writable);
+}
+
+/* Adds page UPAGE of a memory-mapped FILE to the current
+   thread's page table.  The page holds READ_BYTES bytes of FILE
+   starting at FILE_OFS, followed by zeroes, and changes to those
+   bytes are written back to FILE.  FILE must stay open as long
+   as the page exists.  Returns true if successful, false if
+   UPAGE already exists or memory is not available. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t file_ofs,
+               size_t read_bytes)
+{
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (thread_current ()->pages == NULL || page_lookup (upage) != NULL)
+    return false;
+  return new_page (upage, file, file_ofs, 0, read_bytes, true, true) != NULL;
+}
+
+/* Writes page P, which is in frame KPAGE, back to its file. */
+static void
+write_back (struct page *p, const uint8_t *kpage)
+{
+  file_write_at (p->file, kpage + p->page_ofs, p->read_bytes, p->file_ofs);
+}
+
+/* Removes page UPAGE from the current thread's page table,
+   writing it back to its file first if it is a modified page of
+   a memory-mapped file. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+
+  if (p->pinned)
+    unpin (p);
+  if (frame_pin (p))
+    {
+      if (p->write_back && pagedir_is_dirty (t->pagedir, p->upage))
+        write_back (p, p->frame->kpage);
+      frame_unpin (p);
+      frame_free (p);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  hash_delete (t->pages, &p->elem);
+  free (p);
+}
+
+/* Returns true if page P always has the contents of its file,
+   so that its frame can be shared.  Partly filled pages are not
+   shared, because page_add_file() may add the start of the next
+   segment to them.  Only pages of the running executable are
+   shared, since load() denies writes to it until the process
+   exits, so that its contents cannot change while any frame
+   holding one of its pages exists. */
+static bool
+is_shareable (const struct page *p)
+{
+  return (p->file != NULL && p->file == p->thread->exec_file
+          && !p->writable && !p->write_back
+          && p->page_ofs == 0 && p->read_bytes == PGSIZE);
+}
+
+/* Makes page P of the current thread present, reading it in if
+   necessary, and leaves its frame pinned if PIN is true.
+   Returns true if successful, false if no frame is available or
+   the page cannot be read in. */
+static bool
+bring_in (struct page *p, bool pin)
+{
+  struct thread *t = thread_current ();
+  struct frame *f = NULL;
+  bool dirty = false;
+
+  if (!frame_pin (p))
+    {
+      if (is_shareable (p))
+        f = frame_find_shared (p, file_get_inode (p->file), p->file_ofs);
+      if (f == NULL)
+        {
+          f = frame_alloc (p);
+          if (f == NULL)
+            return false;
+
+          if (p->swap_slot != SWAP_NONE)
+            {
+              swap_in (p->swap_slot, f->kpage);
+              p->swap_slot = SWAP_NONE;
+              dirty = true;
+            }
+          else if (!load_page (p, f->kpage))
+            {
+              frame_unpin (p);
+              frame_free (p);
+              return false;
+            }
+          else if (is_shareable (p))
+            frame_share (p, file_get_inode (p->file), p->file_ofs);
+        }
+
+      if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+        {
+          frame_unpin (p);
+          frame_free (p);
+          return false;
+        }
+      if (dirty)
+        pagedir_set_dirty (t->pagedir, p->upage, true);
+    }
+
+  /* The frame is pinned once on our behalf now.  Keep that pin
+     only for a page pinned for the first time. */
+  if (pin && !p->pinned)
+    {
+      p->pinned = true;
+      list_push_back (&t->pinned_pages, &p->pin_elem);
+    }
+  else
+    frame_unpin (p);
+  return true;
+}
+
+/* Makes the current thread's page containing ADDR present,
+   reading it in if necessary and growing the stack if ADDR is an
+   access to it.  Returns true if successful, false if ADDR is not
+   in a page of the process or if the page cannot be read in. */
+bool
+page_in (const void *addr)
+{
+  struct page *p = find_page (addr);
+  return p != NULL && bring_in (p, false);
+}
+
+/* Like page_in(), but also pins the page until the next call to
+   page_unpin_all(). */
+bool
+page_pin (const void *addr)
+{
+  struct page *p = find_page (addr);
+  return p != NULL && bring_in (p, true);
+}
+
+/* Unpins page P, which was pinned by page_pin(). */
+static void
+unpin (struct page *p)
+{
+  ASSERT (p->pinned);
+  list_remove (&p->pin_elem);
+  p->pinned = false;
+  frame_unpin (p);
+}
+
+/* Unpins all the pages pinned by page_pin() in the current
+   thread. */
+void
+page_unpin_all (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages == NULL)
+    return;
+  while (!list_empty (&t->pinned_pages))
+    unpin (list_entry (list_front (&t->pinned_pages), struct page,
+                       pin_elem));
+}
+
+/* Prepares page P for its frame to be reused, by unmapping it
+   and, if it was modified, writing it back to its file if it is
+   memory-mapped or to swap otherwise.  Returns true if
+   successful, false if swap is full.  Called by the frame table
+   with its lock held. */
+bool
+page_out (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+  void *kpage = p->frame->kpage;
+
+  /* Unmap the page first, so that the owner cannot modify it
+     after its dirty bit is read. */
+  pagedir_clear_page (pd, p->upage);
+  if (p->write_back)
+    {
+      if (pagedir_is_dirty (pd, p->upage))
+        write_back (p, kpage);
+    }
+  else if (pagedir_is_dirty (pd, p->upage))
+    {
+      p->swap_slot = swap_out (kpage);
+      if (p->swap_slot == SWAP_NONE)
+        {
+          pagedir_set_page (pd, p->upage, kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, true);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return (hash_entry (a, struct page, elem)->upage
+          < hash_entry (b, struct page, elem)->upage);
+}
@@ -0,0 +1,60 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct thread;
+
+/* A page of a process's virtual address space, as recorded in
+   the process's supplemental page table, which says where the
+   page's contents are while it is not in memory. */
+struct page
+  {
+    struct hash_elem elem;      /* Element in thread's page table. */
+    struct thread *thread;      /* Owning thread. */
+    void *upage;                /* User virtual address. */
+    bool writable;              /* Writable by the process? */
+
+    /* Initial contents: READ_BYTES bytes of FILE starting at
+       FILE_OFS, placed PAGE_OFS bytes into the page, and zeroes
+       elsewhere.  All zeroes if FILE is null and READ_BYTES is
+       zero; only in memory or swap if FILE is null otherwise. */
+    struct file *file;          /* Backing file, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t page_ofs;            /* Offset of file data in page. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+    bool write_back;            /* Write changes back to FILE? */
+
+    /* Owned by vm/frame.c. */
+    struct frame *frame;        /* Frame holding page, or null. */
+    struct list_elem frame_elem; /* Element in frame's page list. */
+
+    size_t swap_slot;           /* Swap slot holding page, or
+                                   SWAP_NONE. */
+    bool pinned;                /* Pinned for a system call? */
+    struct list_elem pin_elem;  /* Element in thread's pinned list. */
+  };
+
+/* Maximum size of a process's stack, in pages. */
+extern size_t stack_page_limit;
+
+bool page_table_create (void);
+void page_table_destroy (void);
+bool page_add_file (void *upage, struct file *, off_t file_ofs,
+                    size_t page_ofs, size_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t file_ofs,
+                    size_t read_bytes);
+void page_remove (void *upage);
+bool page_in (const void *addr);
+bool page_pin (const void *addr);
+void page_unpin_all (void);
+bool page_out (struct page *);
+
+#endif /* vm/page.h */
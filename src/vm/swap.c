@@ -0,0 +1,79 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/disk.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap space.
+
+   Evicted pages that cannot be read back from a file are written
+   to the swap disk, hd1:1, in page-sized slots of consecutive
+   sectors.  A bitmap records which slots are in use. */
+
+/* Number of sectors in a swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct disk *swap_disk;     /* Swap disk, or null if none. */
+static struct bitmap *used_slots;  /* Slots in use. */
+static struct lock swap_lock;      /* Protects USED_SLOTS. */
+
+/* Initializes swap space.  Without a swap disk, pages can still
+   be evicted if they can be read back from files. */
+void
+swap_init (void)
+{
+  lock_init (&swap_lock);
+  swap_disk = disk_get (1, 1);
+  if (swap_disk == NULL)
+    {
+      printf ("swap: hd1:1 (hdd) not present, no swap space\n");
+      used_slots = NULL;
+      return;
+    }
+  used_slots = bitmap_create (disk_size (swap_disk) / SECTORS_PER_SLOT);
+  if (used_slots == NULL)
+    PANIC ("swap bitmap creation failed");
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_NONE if swap space is full. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+
+  if (used_slots == NULL)
+    return SWAP_NONE;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  disk_write_multi (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+                    kpage);
+  return slot;
+}
+
+/* Reads swap slot SLOT into the page at KPAGE and frees the
+   slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  disk_read_multi (swap_disk, slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT,
+                   kpage);
+  swap_free (slot);
+}
+
+/* Frees swap slot SLOT without reading it. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  bitmap_reset (used_slots, slot);
+  lock_release (&swap_lock);
+}